@@ -0,0 +1,187 @@
+#!/usr/bin/env python3
+#
+# Copyright (C) 2026 The Xfce Development Team
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License along
+# with this program; if not, write to the Free Software Foundation, Inc.,
+# 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+#
+
+"""Start the panel with synthetic configurations and report the timing
+spans it recorded (PANEL_DEBUG=trace) for loading and layout.
+
+Runs under an X server (xvfb-run) and starts a new session bus for each
+configuration, so every run gets its own xfconfd. The plugins have to be
+installed in the configured prefix."""
+
+import ast
+import json
+import os
+import random
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+# panels, plugins per panel, rows, percentage of expanding separators
+CASES = [
+    (1, 10, 1, 0),
+    (1, 50, 1, 10),
+    (1, 50, 3, 10),
+    (2, 100, 1, 50),
+    (4, 100, 2, 10),
+]
+
+PLUGINS = ["separator", "showdesktop"]
+
+
+def write_config(path, n_panels, n_plugins, nrows, expand_percent):
+    rand = random.Random(n_panels * 1000 + n_plugins)
+    unique_id = 1
+    panels = []
+    plugins = []
+
+    for panel in range(1, n_panels + 1):
+        ids = []
+        for _ in range(n_plugins):
+            name = rand.choice(PLUGINS)
+            expand = name == "separator" and rand.randrange(100) < expand_percent
+            plugins.append(
+                '    <property name="plugin-%d" type="string" value="%s">\n'
+                '      <property name="expand" type="bool" value="%s"/>\n'
+                "    </property>\n" % (unique_id, name, "true" if expand else "false"))
+            ids.append('        <value type="int" value="%d"/>\n' % unique_id)
+            unique_id += 1
+
+        panels.append(
+            '    <property name="panel-%d" type="empty">\n'
+            '      <property name="position" type="string" value="p=%d;x=0;y=0"/>\n'
+            '      <property name="length" type="uint" value="100"/>\n'
+            '      <property name="position-locked" type="bool" value="true"/>\n'
+            '      <property name="size" type="uint" value="48"/>\n'
+            '      <property name="nrows" type="uint" value="%d"/>\n'
+            '      <property name="plugin-ids" type="array">\n%s'
+            "      </property>\n"
+            "    </property>\n" % (panel, 6 if panel % 2 else 10, nrows, "".join(ids)))
+
+    os.makedirs(os.path.dirname(path), exist_ok=True)
+    with open(path, "w") as f:
+        f.write('<?xml version="1.0" encoding="UTF-8"?>\n'
+                '<channel name="xfce4-panel" version="1.0">\n'
+                '  <property name="configver" type="int" value="2"/>\n'
+                '  <property name="panels" type="array">\n')
+        f.writelines('    <value type="int" value="%d"/>\n' % p for p in range(1, n_panels + 1))
+        f.writelines(panels)
+        f.write("  </property>\n"
+                '  <property name="plugins" type="empty">\n')
+        f.writelines(plugins)
+        f.write("  </property>\n"
+                "</channel>\n")
+
+
+def get_trace():
+    result = subprocess.run(["gdbus", "call", "--session",
+                             "--dest", "org.xfce.Panel",
+                             "--object-path", "/org/xfce/Panel",
+                             "--method", "org.xfce.Panel.GetTrace"],
+                            capture_output=True, text=True)
+    if result.returncode != 0:
+        return None
+    return json.loads(ast.literal_eval(result.stdout.strip())[0])["traceEvents"]
+
+
+def peak_rss(pid):
+    try:
+        with open("/proc/%d/status" % pid) as f:
+            for line in f:
+                if line.startswith("VmHWM:"):
+                    return int(line.split()[1])
+    except OSError:
+        pass
+    return 0
+
+
+def run_case(panel_bin):
+    """Runs in a session bus of its own, prints the trace as json."""
+    env = dict(os.environ, PANEL_DEBUG="trace")
+    panel = subprocess.Popen([panel_bin, "--disable-wm-check"], env=env,
+                             stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+
+    # wait for the load and let the layout settle
+    events = None
+    deadline = time.monotonic() + 60
+    while time.monotonic() < deadline:
+        time.sleep(0.5)
+        events = get_trace()
+        if events and any(e["cat"] == "application" for e in events):
+            time.sleep(2)
+            events = get_trace()
+            break
+
+    rss = peak_rss(panel.pid)
+    subprocess.run([panel_bin, "--quit"], stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    try:
+        panel.wait(10)
+    except subprocess.TimeoutExpired:
+        panel.kill()
+
+    json.dump({"events": events or [], "rss": rss}, sys.stdout)
+
+
+def summarize(events, cat, name):
+    durations = [e["dur"] for e in events if e["cat"] == cat and e["name"] == name]
+    if not durations:
+        return "%s/%s: none" % (cat, name)
+    durations.sort()
+    return "%s/%s: n=%d median=%dus p95=%dus total=%dus" % (
+        cat, name, len(durations), statistics.median(durations),
+        durations[min(len(durations) - 1, int(len(durations) * 0.95))], sum(durations))
+
+
+def main():
+    if len(sys.argv) >= 3 and sys.argv[1] == "--case":
+        run_case(sys.argv[2])
+        return 0
+
+    if len(sys.argv) != 3:
+        print("usage: %s PANEL-BINARY PLUGINS-DATADIR" % sys.argv[0], file=sys.stderr)
+        return 1
+
+    panel_bin, plugins_dir = sys.argv[1], sys.argv[2]
+    if not os.path.exists(os.path.join(plugins_dir, "separator.desktop")):
+        print("plugins are not installed in %s, skipping" % plugins_dir, file=sys.stderr)
+        return 77
+
+    for n_panels, n_plugins, nrows, expand_percent in CASES:
+        with tempfile.TemporaryDirectory(prefix="xfce4-panel-bench-") as tmp:
+            write_config(os.path.join(tmp, "config", "xfce4", "xfconf", "xfce-perchannel-xml", "xfce4-panel.xml"),
+                         n_panels, n_plugins, nrows, expand_percent)
+            env = dict(os.environ,
+                       XDG_CONFIG_HOME=os.path.join(tmp, "config"),
+                       XDG_CACHE_HOME=os.path.join(tmp, "cache"))
+            result = subprocess.run(["dbus-run-session", "--", sys.executable, __file__, "--case", panel_bin],
+                                    env=env, capture_output=True, text=True)
+            data = json.loads(result.stdout or '{"events": [], "rss": 0}')
+
+        print("panels=%d plugins=%d nrows=%d expand=%d%% peak-rss=%dkB" % (
+            n_panels, n_plugins, nrows, expand_percent, data["rss"]))
+        for cat, name in [("application", "load"), ("plugin", "construct"),
+                          ("window", "size-allocate"), ("itembar", "size-allocate")]:
+            print("  " + summarize(data["events"], cat, name))
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
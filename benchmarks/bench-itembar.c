@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 2026 The Xfce Development Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "panel/panel-itembar.h"
+
+#include "common/panel-debug.h"
+#include "common/panel-private.h"
+#include "libxfce4panel/libxfce4panel.h"
+
+#include <gtk/gtk.h>
+#ifdef HAVE_MALLINFO2
+#include <malloc.h>
+#endif
+
+
+
+/* length of the itembar, like a panel on a full hd monitor */
+#define BENCH_LENGTH 1920
+
+
+
+typedef struct _BenchLayout
+{
+  guint n_plugins;
+  guint nrows;
+  guint expand_percent;
+  gboolean shrink;
+} BenchLayout;
+
+
+
+static gint n_iterations = 2000;
+static gint n_storm = 5000;
+
+static GOptionEntry option_entries[] = {
+  { "iterations", 'i', 0, G_OPTION_ARG_INT, &n_iterations, "Allocations per layout", "N" },
+  { "storm", 's', 0, G_OPTION_ARG_INT, &n_storm, "Operations per add/remove/reorder storm", "N" },
+  { NULL }
+};
+
+
+
+static gsize
+bench_heap_in_use (void)
+{
+#ifdef HAVE_MALLINFO2
+  return mallinfo2 ().uordblks;
+#else
+  return 0;
+#endif
+}
+
+
+
+static GtkWidget *
+bench_child_new (GRand *rand)
+{
+  GtkWidget *child;
+
+  /* plugins are a mix of icon buttons and wider labels */
+  child = gtk_drawing_area_new ();
+  gtk_widget_set_size_request (child, g_rand_int_range (rand, 16, 120), 16);
+  gtk_widget_show (child);
+
+  return child;
+}
+
+
+
+static void
+bench_child_set_options (PanelItembar *itembar,
+                         GtkWidget *child,
+                         GRand *rand,
+                         const BenchLayout *layout)
+{
+  gboolean expand, small;
+
+  expand = g_rand_int_range (rand, 0, 100) < (gint) layout->expand_percent;
+  small = layout->nrows > 1 && g_rand_boolean (rand);
+
+  gtk_container_child_set (GTK_CONTAINER (itembar), child,
+                           "expand", expand,
+                           "shrink", !expand && layout->shrink && g_rand_boolean (rand),
+                           "small", small,
+                           NULL);
+}
+
+
+
+static void
+bench_allocate (GtkWidget *itembar,
+                gint length)
+{
+  GtkAllocation alloc = { 0, 0, length, 48 };
+  GtkRequisition requisition;
+
+  /* what the panel window does on each resize */
+  gtk_widget_queue_resize (itembar);
+  gtk_widget_get_preferred_size (itembar, NULL, &requisition);
+  gtk_widget_size_allocate (itembar, &alloc);
+}
+
+
+
+static void
+bench_report (const gchar *name,
+              const BenchLayout *layout,
+              gint64 elapsed,
+              gint n_ops,
+              gssize heap)
+{
+  g_print ("%-10s plugins=%-4u nrows=%u expand=%2u%% shrink=%-5s %9.2f us/op %10" G_GSSIZE_FORMAT " heap bytes\n",
+           name, layout->n_plugins, layout->nrows, layout->expand_percent,
+           PANEL_DEBUG_BOOL (layout->shrink),
+           (gdouble) elapsed / n_ops, heap);
+}
+
+
+
+static void
+bench_layout (const BenchLayout *layout)
+{
+  GtkWidget *window, *itembar, *child;
+  GPtrArray *children;
+  GRand *rand;
+  gint64 start;
+  gsize heap;
+  gint i, idx;
+
+  /* same seed for each run, so results can be compared */
+  rand = g_rand_new_with_seed (layout->n_plugins * 100 + layout->nrows);
+
+  window = gtk_offscreen_window_new ();
+  itembar = panel_itembar_new ();
+  g_object_set (itembar, "size", 48, "nrows", layout->nrows, NULL);
+  gtk_container_add (GTK_CONTAINER (window), itembar);
+
+  children = g_ptr_array_new ();
+  for (i = 0; i < (gint) layout->n_plugins; i++)
+    {
+      child = bench_child_new (rand);
+      panel_itembar_insert (PANEL_ITEMBAR (itembar), child, -1);
+      bench_child_set_options (PANEL_ITEMBAR (itembar), child, rand, layout);
+      g_ptr_array_add (children, child);
+    }
+
+  gtk_widget_show_all (window);
+
+  /* resizing with a fixed set of plugins */
+  heap = bench_heap_in_use ();
+  start = g_get_monotonic_time ();
+  for (i = 0; i < n_iterations; i++)
+    bench_allocate (itembar, BENCH_LENGTH - (i % 64));
+  bench_report ("allocate", layout, g_get_monotonic_time () - start, n_iterations,
+                bench_heap_in_use () - heap);
+
+  /* add, remove and reorder storm, allocating after every few changes
+   * like the panel does once per frame */
+  heap = bench_heap_in_use ();
+  start = g_get_monotonic_time ();
+  for (i = 0; i < n_storm; i++)
+    {
+      switch (g_rand_int_range (rand, 0, 3))
+        {
+        case 0:
+          child = bench_child_new (rand);
+          panel_itembar_insert (PANEL_ITEMBAR (itembar), child,
+                                g_rand_int_range (rand, 0, children->len + 1));
+          bench_child_set_options (PANEL_ITEMBAR (itembar), child, rand, layout);
+          g_ptr_array_add (children, child);
+          break;
+
+        case 1:
+          if (children->len == 0)
+            break;
+          idx = g_rand_int_range (rand, 0, children->len);
+          gtk_container_remove (GTK_CONTAINER (itembar), g_ptr_array_index (children, idx));
+          g_ptr_array_remove_index_fast (children, idx);
+          break;
+
+        default:
+          if (children->len == 0)
+            break;
+          idx = g_rand_int_range (rand, 0, children->len);
+          panel_itembar_reorder_child (PANEL_ITEMBAR (itembar), g_ptr_array_index (children, idx),
+                                       g_rand_int_range (rand, 0, children->len));
+          break;
+        }
+
+      if (i % 8 == 7)
+        bench_allocate (itembar, BENCH_LENGTH);
+    }
+
+  /* release the removed children */
+  while (g_main_context_iteration (NULL, FALSE))
+    ;
+
+  bench_report ("storm", layout, g_get_monotonic_time () - start, n_storm,
+                bench_heap_in_use () - heap);
+
+  g_ptr_array_free (children, TRUE);
+  gtk_widget_destroy (window);
+  g_rand_free (rand);
+}
+
+
+
+gint
+main (gint argc,
+      gchar **argv)
+{
+  const guint n_plugins[] = { 8, 32, 128, 512 };
+  const guint nrows[] = { 1, 2, 3 };
+  const guint expand_percent[] = { 0, 10, 50 };
+  BenchLayout layout;
+  GError *error = NULL;
+  guint i, j, k;
+
+  if (!gtk_init_with_args (&argc, &argv, NULL, option_entries, NULL, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      g_error_free (error);
+      return 1;
+    }
+
+  for (i = 0; i < G_N_ELEMENTS (n_plugins); i++)
+    for (j = 0; j < G_N_ELEMENTS (nrows); j++)
+      for (k = 0; k < G_N_ELEMENTS (expand_percent); k++)
+        {
+          layout.n_plugins = n_plugins[i];
+          layout.nrows = nrows[j];
+          layout.expand_percent = expand_percent[k];
+          layout.shrink = k > 0;
+          bench_layout (&layout);
+        }
+
+  return 0;
+}
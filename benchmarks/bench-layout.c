@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2026 The Xfce Development Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "panel/panel-layout.h"
+
+#include "common/panel-private.h"
+
+#include <gtk/gtk.h>
+
+
+
+/* panels per monitor, like a top and bottom panel */
+#define BENCH_PANELS_PER_MONITOR (2)
+
+
+
+typedef struct _BenchSolve
+{
+  PanelLayoutSnapshot *snapshot;
+  PanelLayoutPanel *panels;
+  PanelLayoutResult *results;
+  guint n_panels;
+  gint64 elapsed;
+} BenchSolve;
+
+
+
+static gint n_iterations = 20000;
+
+static GOptionEntry option_entries[] = {
+  { "iterations", 'i', 0, G_OPTION_ARG_INT, &n_iterations, "Solves per layout", "N" },
+  { NULL }
+};
+
+
+
+static PanelLayoutSnapshot *
+bench_snapshot_new (guint n_monitors)
+{
+  PanelLayoutSnapshot *snapshot;
+  GdkRectangle geometry = { 0, 0, 1920, 1080 };
+  gchar *connector;
+  guint i;
+
+  /* monitors side by side, like a laptop on a docking station */
+  snapshot = panel_layout_snapshot_new ();
+  for (i = 0; i < n_monitors; i++)
+    {
+      connector = g_strdup_printf ("DP-%u", i + 1);
+      panel_layout_snapshot_add_monitor (snapshot, &geometry, connector, i == 0);
+      g_free (connector);
+      geometry.x += geometry.width;
+    }
+
+  return snapshot;
+}
+
+
+
+static gpointer
+bench_solve (gpointer data)
+{
+  BenchSolve *solve = data;
+  gint64 start;
+  gint i;
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < n_iterations; i++)
+    panel_layout_solve (solve->snapshot, solve->panels, solve->results, solve->n_panels);
+  solve->elapsed = g_get_monotonic_time () - start;
+
+  return NULL;
+}
+
+
+
+static void
+bench_report (const gchar *name,
+              guint n_monitors,
+              guint n_panels,
+              gint64 elapsed)
+{
+  g_print ("%-8s monitors=%-3u panels=%-3u %9.3f us/solve\n",
+           name, n_monitors, n_panels, (gdouble) elapsed / n_iterations);
+}
+
+
+
+static void
+bench_layout (guint n_monitors)
+{
+  BenchSolve solve;
+  GPtrArray *names;
+  GThread *thread;
+  gint64 start;
+  guint i;
+
+  solve.snapshot = bench_snapshot_new (n_monitors);
+  solve.n_panels = n_monitors * BENCH_PANELS_PER_MONITOR;
+  solve.panels = g_new0 (PanelLayoutPanel, solve.n_panels);
+  solve.results = g_new0 (PanelLayoutResult, solve.n_panels);
+
+  /* a mix of the output-name settings found in configurations */
+  names = g_ptr_array_new_with_free_func (g_free);
+  for (i = 0; i < solve.n_panels; i++)
+    {
+      switch (i % 4)
+        {
+        case 0:
+          solve.panels[i].output_name = "Automatic";
+          break;
+
+        case 1:
+          solve.panels[i].output_name = "Primary";
+          break;
+
+        case 2:
+          g_ptr_array_add (names, g_strdup_printf ("DP-%u", i / BENCH_PANELS_PER_MONITOR + 1));
+          solve.panels[i].output_name = g_ptr_array_index (names, names->len - 1);
+          break;
+
+        default:
+          g_ptr_array_add (names, g_strdup_printf ("monitor-%u-DP-%u",
+                                                   i / BENCH_PANELS_PER_MONITOR,
+                                                   i / BENCH_PANELS_PER_MONITOR + 1));
+          solve.panels[i].output_name = g_ptr_array_index (names, names->len - 1);
+          break;
+        }
+
+      solve.panels[i].span_monitors = FALSE;
+      solve.panels[i].base_x = (i / BENCH_PANELS_PER_MONITOR) * 1920 + 960;
+      solve.panels[i].base_y = i % BENCH_PANELS_PER_MONITOR == 0 ? 16 : 1064;
+    }
+
+  /* on the main thread */
+  bench_solve (&solve);
+  bench_report ("main", n_monitors, solve.n_panels, solve.elapsed);
+
+  /* the snapshot is immutable, so the solver can run in a worker */
+  start = g_get_monotonic_time ();
+  thread = g_thread_new ("bench-layout", bench_solve, &solve);
+  g_thread_join (thread);
+  bench_report ("thread", n_monitors, solve.n_panels, g_get_monotonic_time () - start);
+
+  g_ptr_array_free (names, TRUE);
+  g_free (solve.panels);
+  g_free (solve.results);
+  panel_layout_snapshot_unref (solve.snapshot);
+}
+
+
+
+gint
+main (gint argc,
+      gchar **argv)
+{
+  const guint n_monitors[] = { 1, 2, 4, 8, 16 };
+  GOptionContext *context;
+  GError *error = NULL;
+  guint i;
+
+  context = g_option_context_new (NULL);
+  g_option_context_add_main_entries (context, option_entries, NULL);
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      g_error_free (error);
+      g_option_context_free (context);
+      return 1;
+    }
+  g_option_context_free (context);
+
+  for (i = 0; i < G_N_ELEMENTS (n_monitors); i++)
+    bench_layout (n_monitors[i]);
+
+  return 0;
+}
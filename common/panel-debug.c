@@ -48,6 +48,8 @@ static const GDebugKey panel_debug_keys[] = {
   { "itembar", PANEL_DEBUG_ITEMBAR },
   { "clock", PANEL_DEBUG_CLOCK },
   { "actions", PANEL_DEBUG_ACTIONS },
+  { "xfconf", PANEL_DEBUG_XFCONF },
+  { "trace", PANEL_DEBUG_TRACE },
 };
 
 
@@ -113,7 +115,7 @@ panel_debug_print (PanelDebugFlag domain,
 gboolean
 panel_debug_has_domain (PanelDebugFlag domain)
 {
-  return PANEL_HAS_FLAG (panel_debug_flags, domain);
+  return PANEL_HAS_FLAG (panel_debug_init (), domain);
 }
 
 
@@ -50,6 +50,8 @@ typedef enum
   PANEL_DEBUG_ITEMBAR = 1 << 16,
   PANEL_DEBUG_CLOCK = 1 << 17,
   PANEL_DEBUG_ACTIONS = 1 << 18,
+  PANEL_DEBUG_XFCONF = 1 << 19,
+  PANEL_DEBUG_TRACE = 1 << 20,
 } PanelDebugFlag;
 
 gboolean
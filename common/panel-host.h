@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2026 The Xfce Development Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __PANEL_HOST_H__
+#define __PANEL_HOST_H__
+
+#include <glib.h>
+
+/* protocol between the panel and a wrapper started in host mode, which
+ * runs several external plugins of the same host group in one process;
+ * messages are exchanged over a SOCK_SEQPACKET socket pair */
+#define PANEL_HOST_ARGUMENT "--host"
+#define PANEL_HOST_SOCKET_FD 3
+
+/* a request: command, unique id, signal and the plugin argv */
+#define PANEL_HOST_REQUEST_TYPE "(uiias)"
+#define PANEL_HOST_MAX_REQUEST (16 * 1024)
+
+enum
+{
+  PANEL_HOST_REQUEST_ADD, /* start the plugin described by argv */
+  PANEL_HOST_REQUEST_REMOVE, /* stop the plugin as if it got the signal */
+};
+
+/* sent when a plugin left the host, status is encoded like a wait
+ * status so the panel can handle it as the exit of a wrapper */
+typedef struct
+{
+  gint32 unique_id;
+  gint32 status;
+} PanelHostReply;
+
+#endif /* !__PANEL_HOST_H__ */
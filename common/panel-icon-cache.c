@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2026 The Xfce Development Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "panel-icon-cache.h"
+#include "panel-private.h"
+
+#include <libxfce4ui/libxfce4ui.h>
+
+
+
+/* number of surfaces kept alive by the cache, widgets hold their
+ * own reference so evicting a surface does not affect them */
+#define PANEL_ICON_CACHE_SIZE (64)
+
+
+
+typedef struct _PanelIconCacheEntry
+{
+  gchar *key;
+  cairo_surface_t *surface;
+  GList *link;
+} PanelIconCacheEntry;
+
+
+
+static GHashTable *cache_table = NULL;
+static GQueue cache_lru = G_QUEUE_INIT;
+static GQuark cache_digest_quark = 0;
+
+
+
+static void
+panel_icon_cache_entry_free (gpointer data)
+{
+  PanelIconCacheEntry *entry = data;
+
+  g_queue_delete_link (&cache_lru, entry->link);
+  cairo_surface_destroy (entry->surface);
+  g_free (entry->key);
+  g_slice_free (PanelIconCacheEntry, entry);
+}
+
+
+
+static const gchar *
+panel_icon_cache_digest (GdkPixbuf *pixbuf)
+{
+  gchar *digest;
+
+  /* libxfce4windowing returns the same pixbuf for a window until its
+   * icon changes, so the pixel data is only hashed once */
+  digest = g_object_get_qdata (G_OBJECT (pixbuf), cache_digest_quark);
+  if (digest == NULL)
+    {
+      digest = g_compute_checksum_for_data (G_CHECKSUM_MD5,
+                                            gdk_pixbuf_read_pixels (pixbuf),
+                                            gdk_pixbuf_get_byte_length (pixbuf));
+      g_object_set_qdata_full (G_OBJECT (pixbuf), cache_digest_quark, digest, g_free);
+    }
+
+  return digest;
+}
+
+
+
+static cairo_surface_t *
+panel_icon_cache_surface_new (GdkPixbuf *pixbuf,
+                              gint max_size,
+                              gint scale_factor,
+                              gint lucency)
+{
+  GdkPixbuf *scaled = NULL, *lucent = NULL;
+  cairo_surface_t *surface;
+
+  /* scale the icon if needed */
+  if (max_size > 0
+      && (gdk_pixbuf_get_width (pixbuf) > max_size
+          || gdk_pixbuf_get_height (pixbuf) > max_size))
+    {
+      scaled = gdk_pixbuf_scale_simple (pixbuf, max_size, max_size, GDK_INTERP_BILINEAR);
+      if (G_LIKELY (scaled != NULL))
+        pixbuf = scaled;
+    }
+
+  /* dimm the icon */
+  if (lucency < 100)
+    {
+      lucent = xfce_gdk_pixbuf_lucent (pixbuf, lucency);
+      if (G_LIKELY (lucent != NULL))
+        pixbuf = lucent;
+    }
+
+  surface = gdk_cairo_surface_create_from_pixbuf (pixbuf, scale_factor, NULL);
+
+  if (lucent != NULL)
+    g_object_unref (G_OBJECT (lucent));
+  if (scaled != NULL)
+    g_object_unref (G_OBJECT (scaled));
+
+  return surface;
+}
+
+
+
+/* returns a surface for pixbuf, shared with every caller asking for an icon
+ * with the same pixel data, so windows of the same application end up on a
+ * single surface; max_size is in device pixels and 0 disables scaling */
+cairo_surface_t *
+panel_icon_cache_lookup (GdkPixbuf *pixbuf,
+                         gint max_size,
+                         gint scale_factor,
+                         gint lucency)
+{
+  PanelIconCacheEntry *entry;
+  gchar *key;
+
+  panel_return_val_if_fail (GDK_IS_PIXBUF (pixbuf), NULL);
+
+  if (G_UNLIKELY (cache_table == NULL))
+    {
+      cache_table = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, panel_icon_cache_entry_free);
+      cache_digest_quark = g_quark_from_static_string ("panel-icon-cache-digest");
+    }
+
+  key = g_strdup_printf ("%s-%dx%d-%d-%d-%d", panel_icon_cache_digest (pixbuf),
+                         gdk_pixbuf_get_width (pixbuf), gdk_pixbuf_get_height (pixbuf),
+                         max_size, scale_factor, CLAMP (lucency, 0, 100));
+
+  entry = g_hash_table_lookup (cache_table, key);
+  if (entry != NULL)
+    {
+      /* move to the front of the lru list */
+      g_queue_unlink (&cache_lru, entry->link);
+      g_queue_push_head_link (&cache_lru, entry->link);
+      g_free (key);
+
+      return cairo_surface_reference (entry->surface);
+    }
+
+  entry = g_slice_new0 (PanelIconCacheEntry);
+  entry->key = key;
+  entry->surface = panel_icon_cache_surface_new (pixbuf, max_size, scale_factor, lucency);
+  g_queue_push_head (&cache_lru, entry);
+  entry->link = cache_lru.head;
+  g_hash_table_insert (cache_table, entry->key, entry);
+
+  /* drop the least recently used surfaces */
+  while (cache_lru.length > PANEL_ICON_CACHE_SIZE)
+    g_hash_table_remove (cache_table, ((PanelIconCacheEntry *) cache_lru.tail->data)->key);
+
+  return cairo_surface_reference (entry->surface);
+}
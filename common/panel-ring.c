@@ -0,0 +1,439 @@
+/*
+ * Copyright (C) 2026 The Xfce Development Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifdef HAVE_MEMFD_CREATE
+#define _GNU_SOURCE
+#endif
+
+#include "panel-debug.h"
+#include "panel-private.h"
+#include "panel-ring.h"
+
+#include <gio/gio.h>
+
+#ifdef HAVE_MEMFD_CREATE
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+
+/* size of the data area, must be a power of two */
+#define PANEL_RING_SIZE (64 * 1024)
+#define PANEL_RING_MAGIC 0x50524e47
+
+
+
+/* a single-producer single-consumer byte ring: the panel appends
+ * length-prefixed serialized variants at head, the wrapper consumes
+ * them at tail, both offsets grow monotonically and wrap at 2^32 */
+typedef struct _PanelRingHeader
+{
+  guint32 magic;
+  guint32 size;
+  gint attached;
+  guint head;
+  guint tail;
+} PanelRingHeader;
+
+struct _PanelRing
+{
+  gint shm_fd;
+  gint event_fd;
+  gsize length;
+
+  PanelRingHeader *header;
+  guint8 *data;
+
+  guint producer : 1;
+  guint broken : 1;
+};
+
+
+
+#ifdef HAVE_MEMFD_CREATE
+static void
+panel_ring_set_error (GError **error,
+                      const gchar *what)
+{
+  gint errsv = errno;
+
+  g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+               "%s failed: %s", what, g_strerror (errsv));
+}
+
+
+
+static gboolean
+panel_ring_map (PanelRing *ring,
+                GError **error)
+{
+  gpointer map;
+
+  map = mmap (NULL, ring->length, PROT_READ | PROT_WRITE, MAP_SHARED, ring->shm_fd, 0);
+  if (map == MAP_FAILED)
+    {
+      panel_ring_set_error (error, "mmap");
+      return FALSE;
+    }
+
+  ring->header = map;
+  ring->data = (guint8 *) map + sizeof (PanelRingHeader);
+
+  return TRUE;
+}
+
+
+
+static void
+panel_ring_read (PanelRing *ring,
+                 guint offset,
+                 gpointer dest,
+                 gsize len)
+{
+  gsize pos = offset & (PANEL_RING_SIZE - 1);
+  gsize first = MIN (len, PANEL_RING_SIZE - pos);
+
+  memcpy (dest, ring->data + pos, first);
+  if (first < len)
+    memcpy ((guint8 *) dest + first, ring->data, len - first);
+}
+
+
+
+static void
+panel_ring_write (PanelRing *ring,
+                  guint offset,
+                  gconstpointer src,
+                  gsize len)
+{
+  gsize pos = offset & (PANEL_RING_SIZE - 1);
+  gsize first = MIN (len, PANEL_RING_SIZE - pos);
+
+  memcpy (ring->data + pos, src, first);
+  if (first < len)
+    memcpy (ring->data, (const guint8 *) src + first, len - first);
+}
+#endif
+
+
+
+PanelRing *
+panel_ring_new (GError **error)
+{
+#ifdef HAVE_MEMFD_CREATE
+  PanelRing *ring;
+
+  ring = g_slice_new0 (PanelRing);
+  ring->producer = TRUE;
+  ring->event_fd = -1;
+  ring->length = sizeof (PanelRingHeader) + PANEL_RING_SIZE;
+
+  /* seal the size so the wrapper can never see the mapping shrink */
+  ring->shm_fd = memfd_create ("xfce4-panel-ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (ring->shm_fd == -1)
+    {
+      panel_ring_set_error (error, "memfd_create");
+      goto failed;
+    }
+
+  if (ftruncate (ring->shm_fd, ring->length) == -1)
+    {
+      panel_ring_set_error (error, "ftruncate");
+      goto failed;
+    }
+
+  if (fcntl (ring->shm_fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) == -1)
+    {
+      panel_ring_set_error (error, "fcntl");
+      goto failed;
+    }
+
+  ring->event_fd = eventfd (0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (ring->event_fd == -1)
+    {
+      panel_ring_set_error (error, "eventfd");
+      goto failed;
+    }
+
+  if (!panel_ring_map (ring, error))
+    goto failed;
+
+  ring->header->magic = PANEL_RING_MAGIC;
+  ring->header->size = PANEL_RING_SIZE;
+
+  return ring;
+
+failed:
+  panel_ring_free (ring);
+
+  return NULL;
+#else
+  g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                       "Shared memory rings are not supported on this platform");
+
+  return NULL;
+#endif
+}
+
+
+
+PanelRing *
+panel_ring_new_from_fds (gint shm_fd,
+                         gint event_fd,
+                         GError **error)
+{
+#ifdef HAVE_MEMFD_CREATE
+  PanelRing *ring;
+  struct stat st;
+
+  /* the descriptors were inherited, do not leak them into plugin children */
+  if (fcntl (shm_fd, F_SETFD, FD_CLOEXEC) == -1
+      || fcntl (event_fd, F_SETFD, FD_CLOEXEC) == -1)
+    {
+      panel_ring_set_error (error, "fcntl");
+      return NULL;
+    }
+
+  if (fstat (shm_fd, &st) == -1)
+    {
+      panel_ring_set_error (error, "fstat");
+      return NULL;
+    }
+
+  if ((gsize) st.st_size != sizeof (PanelRingHeader) + PANEL_RING_SIZE)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                   "Unexpected ring size %" G_GINT64_FORMAT, (gint64) st.st_size);
+      return NULL;
+    }
+
+  ring = g_slice_new0 (PanelRing);
+  ring->shm_fd = shm_fd;
+  ring->event_fd = event_fd;
+  ring->length = st.st_size;
+
+  if (!panel_ring_map (ring, error))
+    {
+      panel_ring_free (ring);
+      return NULL;
+    }
+
+  if (ring->header->magic != PANEL_RING_MAGIC
+      || ring->header->size != PANEL_RING_SIZE)
+    {
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                           "Invalid ring header");
+      panel_ring_free (ring);
+      return NULL;
+    }
+
+  /* from now on the panel may send properties through the ring */
+  g_atomic_int_set (&ring->header->attached, TRUE);
+
+  return ring;
+#else
+  g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                       "Shared memory rings are not supported on this platform");
+
+  return NULL;
+#endif
+}
+
+
+
+void
+panel_ring_free (PanelRing *ring)
+{
+#ifdef HAVE_MEMFD_CREATE
+  if (ring == NULL)
+    return;
+
+  if (ring->header != NULL)
+    munmap (ring->header, ring->length);
+  if (ring->shm_fd != -1)
+    close (ring->shm_fd);
+  if (ring->event_fd != -1)
+    close (ring->event_fd);
+
+  g_slice_free (PanelRing, ring);
+#endif
+}
+
+
+
+gint
+panel_ring_get_shm_fd (PanelRing *ring)
+{
+  panel_return_val_if_fail (ring != NULL, -1);
+
+  return ring->shm_fd;
+}
+
+
+
+gint
+panel_ring_get_event_fd (PanelRing *ring)
+{
+  panel_return_val_if_fail (ring != NULL, -1);
+
+  return ring->event_fd;
+}
+
+
+
+gboolean
+panel_ring_push (PanelRing *ring,
+                 GVariant *parameters)
+{
+#ifdef HAVE_MEMFD_CREATE
+  GVariant *boxed;
+  guint head, tail;
+  guint32 len;
+  gpointer buffer;
+  guint64 one = 1;
+
+  panel_return_val_if_fail (ring != NULL && ring->producer, FALSE);
+  panel_return_val_if_fail (parameters != NULL, FALSE);
+
+  /* nobody is reading yet, or the consumer messed up the offsets */
+  if (ring->broken || !g_atomic_int_get (&ring->header->attached))
+    return FALSE;
+
+  head = ring->header->head;
+  tail = g_atomic_int_get (&ring->header->tail);
+  if (head - tail > PANEL_RING_SIZE)
+    {
+      ring->broken = TRUE;
+      return FALSE;
+    }
+
+  /* box the tuple so the record describes its own type */
+  boxed = g_variant_ref_sink (g_variant_new_variant (parameters));
+  len = g_variant_get_size (boxed);
+  if (sizeof (len) + len > PANEL_RING_SIZE - (head - tail))
+    {
+      panel_debug (PANEL_DEBUG_EXTERNAL, "Ring full, %u bytes pending", head - tail);
+      g_variant_unref (boxed);
+      return FALSE;
+    }
+
+  buffer = g_malloc (len);
+  g_variant_store (boxed, buffer);
+  panel_ring_write (ring, head, &len, sizeof (len));
+  panel_ring_write (ring, head + sizeof (len), buffer, len);
+  g_free (buffer);
+  g_variant_unref (boxed);
+
+  /* publish the record before waking up the consumer */
+  g_atomic_int_set (&ring->header->head, head + sizeof (len) + len);
+
+  if (write (ring->event_fd, &one, sizeof (one)) == -1 && errno != EAGAIN)
+    panel_debug (PANEL_DEBUG_EXTERNAL, "Failed to signal ring: %s", g_strerror (errno));
+
+  return TRUE;
+#else
+  return FALSE;
+#endif
+}
+
+
+
+GVariant *
+panel_ring_pop (PanelRing *ring)
+{
+#ifdef HAVE_MEMFD_CREATE
+  GVariant *boxed, *parameters;
+  GBytes *bytes;
+  guint head, tail;
+  guint32 len;
+  gpointer buffer;
+
+  panel_return_val_if_fail (ring != NULL && !ring->producer, NULL);
+
+  if (ring->broken)
+    return NULL;
+
+  tail = ring->header->tail;
+  head = g_atomic_int_get (&ring->header->head);
+  if (head == tail)
+    return NULL;
+
+  /* the producer is another process, validate everything */
+  if (head - tail > PANEL_RING_SIZE || head - tail < sizeof (len))
+    goto corrupt;
+
+  panel_ring_read (ring, tail, &len, sizeof (len));
+  if (len > head - tail - sizeof (len))
+    goto corrupt;
+
+  buffer = g_malloc (len);
+  panel_ring_read (ring, tail + sizeof (len), buffer, len);
+  g_atomic_int_set (&ring->header->tail, tail + sizeof (len) + len);
+
+  bytes = g_bytes_new_take (buffer, len);
+  boxed = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE_VARIANT, bytes, FALSE));
+  parameters = g_variant_get_variant (boxed);
+  g_variant_unref (boxed);
+  g_bytes_unref (bytes);
+
+  if (!g_variant_is_of_type (parameters, G_VARIANT_TYPE_TUPLE))
+    {
+      g_warning ("Ring record expects a tuple type, but %s received",
+                 g_variant_get_type_string (parameters));
+      g_variant_unref (parameters);
+
+      /* skip the record */
+      return panel_ring_pop (ring);
+    }
+
+  return parameters;
+
+corrupt:
+  g_warning ("Property ring is corrupt, falling back to D-Bus");
+  ring->broken = TRUE;
+
+  /* make the panel stop using the ring */
+  g_atomic_int_set (&ring->header->attached, FALSE);
+
+  return NULL;
+#else
+  return NULL;
+#endif
+}
+
+
+
+void
+panel_ring_acknowledge (PanelRing *ring)
+{
+#ifdef HAVE_MEMFD_CREATE
+  guint64 counter;
+
+  panel_return_if_fail (ring != NULL);
+
+  /* reset the eventfd counter, records are drained by offset */
+  if (read (ring->event_fd, &counter, sizeof (counter)) == -1 && errno != EAGAIN)
+    panel_debug (PANEL_DEBUG_EXTERNAL, "Failed to read ring event: %s", g_strerror (errno));
+#endif
+}
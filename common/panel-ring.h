@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2026 The Xfce Development Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __PANEL_RING_H__
+#define __PANEL_RING_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* environment variable used to tell the wrapper which inherited
+ * file descriptors hold the ring, formatted as "<shm-fd>,<event-fd>" */
+#define PANEL_RING_ENVIRONMENT "XFCE_PANEL_WRAPPER_RING"
+
+typedef struct _PanelRing PanelRing;
+
+PanelRing *
+panel_ring_new (GError **error) G_GNUC_MALLOC;
+
+PanelRing *
+panel_ring_new_from_fds (gint shm_fd,
+                         gint event_fd,
+                         GError **error) G_GNUC_MALLOC;
+
+void
+panel_ring_free (PanelRing *ring);
+
+gint
+panel_ring_get_shm_fd (PanelRing *ring);
+
+gint
+panel_ring_get_event_fd (PanelRing *ring);
+
+gboolean
+panel_ring_push (PanelRing *ring,
+                 GVariant *parameters);
+
+GVariant *
+panel_ring_pop (PanelRing *ring);
+
+void
+panel_ring_acknowledge (PanelRing *ring);
+
+G_END_DECLS
+
+#endif /* !__PANEL_RING_H__ */
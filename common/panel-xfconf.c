@@ -16,39 +16,69 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include "panel-debug.h"
 #include "panel-private.h"
 #include "panel-xfconf.h"
 
 #include "libxfce4panel/libxfce4panel.h"
 
+#include <string.h>
+
+
+
+typedef struct _PanelPropertyBinding
+{
+  XfconfChannel *channel;
+  gchar *xfconf_property;
+  GType xfconf_property_type;
+  gulong channel_handler_id;
+
+  GObject *object;
+  GParamSpec *pspec;
+  gulong object_handler_id;
+
+  /* value waiting to be written to the channel */
+  GValue pending;
+  GList *pending_link;
+} PanelPropertyBinding;
+
+
+
+static GQuark bindings_quark = 0;
+
+/* bindings with a pending value, written in one go from an idle */
+static GQueue pending_bindings = G_QUEUE_INIT;
+static guint pending_flush_id = 0;
+
+/* statistics for the debug output */
+static guint n_requests_saved = 0;
+static guint n_writes_coalesced = 0;
+
 
 
 static void
-panel_properties_store_value (XfconfChannel *channel,
+panel_properties_write_value (XfconfChannel *channel,
                               const gchar *xfconf_property,
-                              GType xfconf_property_type,
-                              GObject *object,
-                              const gchar *object_property)
+                              const GValue *value)
 {
-  GValue value = G_VALUE_INIT;
   GdkRGBA *rgba;
 
-  panel_return_if_fail (G_IS_OBJECT (object));
   panel_return_if_fail (XFCONF_IS_CHANNEL (channel));
+  panel_return_if_fail (G_IS_VALUE (value));
 
   /* write the property to the xfconf channel */
-  g_value_init (&value, xfconf_property_type);
-  g_object_get_property (G_OBJECT (object), object_property, &value);
-
-  if (G_LIKELY (xfconf_property_type != GDK_TYPE_RGBA))
+  if (G_LIKELY (G_VALUE_TYPE (value) != GDK_TYPE_RGBA))
     {
-      xfconf_channel_set_property (channel, xfconf_property, &value);
+      xfconf_channel_set_property (channel, xfconf_property, value);
     }
   else
     {
       /* work around xfconf's lack of storing colors (bug #7117) and
        * do the same as xfconf_g_property_bind_gdkcolor() does */
-      rgba = g_value_get_boxed (&value);
+      rgba = g_value_get_boxed (value);
+      if (G_UNLIKELY (rgba == NULL))
+        return;
+
       xfconf_channel_set_array (channel, xfconf_property,
                                 G_TYPE_DOUBLE, &rgba->red,
                                 G_TYPE_DOUBLE, &rgba->green,
@@ -56,8 +86,320 @@ panel_properties_store_value (XfconfChannel *channel,
                                 G_TYPE_DOUBLE, &rgba->alpha,
                                 G_TYPE_INVALID);
     }
+}
+
+
+
+static gboolean
+panel_properties_value_to_rgba (const GValue *value,
+                                GdkRGBA *rgba)
+{
+  GPtrArray *array;
+  gdouble *components[] = { &rgba->red, &rgba->green, &rgba->blue, &rgba->alpha };
+  guint i;
+
+  if (!G_VALUE_HOLDS (value, G_TYPE_PTR_ARRAY))
+    return FALSE;
+
+  array = g_value_get_boxed (value);
+  if (array == NULL || array->len != G_N_ELEMENTS (components))
+    return FALSE;
+
+  for (i = 0; i < array->len; i++)
+    {
+      if (!G_VALUE_HOLDS_DOUBLE (g_ptr_array_index (array, i)))
+        return FALSE;
+      *components[i] = g_value_get_double (g_ptr_array_index (array, i));
+    }
+
+  return TRUE;
+}
+
+
+
+static void
+panel_properties_binding_apply (PanelPropertyBinding *binding,
+                                const GValue *value)
+{
+  GValue dest = G_VALUE_INIT;
+  GdkRGBA rgba;
+
+  g_value_init (&dest, binding->pspec->value_type);
+
+  if (G_VALUE_TYPE (value) == G_TYPE_INVALID)
+    {
+      /* the property was reset in the channel */
+      g_param_value_set_default (binding->pspec, &dest);
+    }
+  else if (binding->xfconf_property_type == GDK_TYPE_RGBA)
+    {
+      if (!panel_properties_value_to_rgba (value, &rgba))
+        {
+          g_value_unset (&dest);
+          return;
+        }
+
+      g_value_set_boxed (&dest, &rgba);
+    }
+  else if (!g_value_type_transformable (G_VALUE_TYPE (value), binding->pspec->value_type)
+           || !g_value_transform (value, &dest))
+    {
+      g_warning ("Unable to convert xfconf property \"%s\" of type %s to %s",
+                 binding->xfconf_property, G_VALUE_TYPE_NAME (value),
+                 g_type_name (binding->pspec->value_type));
+      g_value_unset (&dest);
+      return;
+    }
+
+  /* do not write the value back to the channel */
+  g_signal_handler_block (binding->object, binding->object_handler_id);
+  g_object_set_property (binding->object, binding->pspec->name, &dest);
+  g_signal_handler_unblock (binding->object, binding->object_handler_id);
+
+  g_value_unset (&dest);
+}
+
+
+
+static void
+panel_properties_binding_unlink (PanelPropertyBinding *binding)
+{
+  if (binding->pending_link != NULL)
+    {
+      g_queue_delete_link (&pending_bindings, binding->pending_link);
+      binding->pending_link = NULL;
+    }
+}
+
+
+
+static void
+panel_properties_binding_dequeue (PanelPropertyBinding *binding)
+{
+  panel_properties_binding_unlink (binding);
+
+  if (G_IS_VALUE (&binding->pending))
+    g_value_unset (&binding->pending);
+}
+
+
+
+static void
+panel_properties_binding_write (PanelPropertyBinding *binding)
+{
+  panel_properties_binding_unlink (binding);
+
+  if (!G_IS_VALUE (&binding->pending))
+    return;
+
+  /* do not apply our own change to the object again */
+  g_signal_handler_block (binding->channel, binding->channel_handler_id);
+  panel_properties_write_value (binding->channel, binding->xfconf_property, &binding->pending);
+  g_signal_handler_unblock (binding->channel, binding->channel_handler_id);
+
+  g_value_unset (&binding->pending);
+}
+
+
+
+static gboolean
+panel_properties_flush (gpointer data)
+{
+  PanelPropertyBinding *binding;
+  guint n_writes = 0;
+
+  pending_flush_id = 0;
+
+  /* write in the order the properties changed, bindings are removed from
+   * the queue one by one, in case one is destroyed during a write */
+  while (!g_queue_is_empty (&pending_bindings))
+    {
+      binding = g_queue_peek_head (&pending_bindings);
+      if (G_IS_VALUE (&binding->pending))
+        n_writes++;
+      panel_properties_binding_write (binding);
+    }
+
+  if (n_writes_coalesced > 0)
+    panel_debug_filtered (PANEL_DEBUG_XFCONF, "wrote %u properties, %u writes coalesced",
+                          n_writes, n_writes_coalesced);
+  n_writes_coalesced = 0;
+
+  return FALSE;
+}
+
+
+
+static void
+panel_properties_binding_queue (PanelPropertyBinding *binding)
+{
+  if (G_IS_VALUE (&binding->pending))
+    {
+      /* replace the value of an earlier change in this iteration */
+      g_value_unset (&binding->pending);
+      n_writes_coalesced++;
+    }
+  else if (binding->pending_link == NULL)
+    {
+      g_queue_push_tail (&pending_bindings, binding);
+      binding->pending_link = g_queue_peek_tail_link (&pending_bindings);
+    }
+
+  /* take a copy of the value now, so it can still be written if the
+   * object is finalized before the next flush */
+  g_value_init (&binding->pending, binding->xfconf_property_type);
+  g_object_get_property (binding->object, binding->pspec->name, &binding->pending);
+
+  if (pending_flush_id == 0)
+    pending_flush_id = g_idle_add (panel_properties_flush, NULL);
+}
+
+
+
+static void
+panel_properties_object_notify (GObject *object,
+                                GParamSpec *pspec,
+                                PanelPropertyBinding *binding)
+{
+  panel_return_if_fail (binding->object == object);
+
+  panel_properties_binding_queue (binding);
+}
+
+
+
+static void
+panel_properties_channel_changed (XfconfChannel *channel,
+                                  const gchar *property,
+                                  const GValue *value,
+                                  PanelPropertyBinding *binding)
+{
+  panel_return_if_fail (binding->channel == channel);
+
+  /* the value in the channel is newer than a pending write */
+  if (G_IS_VALUE (&binding->pending))
+    g_value_unset (&binding->pending);
+
+  panel_properties_binding_apply (binding, value);
+}
+
+
+
+static void
+panel_properties_binding_free (gpointer data)
+{
+  PanelPropertyBinding *binding = data;
+
+  /* pending values are written on dispose, this runs on finalize, when
+   * xfconf might already be shut down, so only drop the value here */
+  panel_properties_binding_dequeue (binding);
+
+  g_signal_handler_disconnect (binding->channel, binding->channel_handler_id);
+  if (g_signal_handler_is_connected (binding->object, binding->object_handler_id))
+    g_signal_handler_disconnect (binding->object, binding->object_handler_id);
+
+  g_object_unref (binding->channel);
+  g_free (binding->xfconf_property);
+  g_slice_free (PanelPropertyBinding, binding);
+}
+
+
+
+static void
+panel_properties_bindings_free (gpointer data)
+{
+  g_slist_free_full (data, panel_properties_binding_free);
+}
+
+
+
+static void
+panel_properties_bindings_write (GObject *object)
+{
+  GSList *li;
+
+  for (li = g_object_get_qdata (object, bindings_quark); li != NULL; li = li->next)
+    panel_properties_binding_write (li->data);
+}
+
+
+
+static void
+panel_properties_object_disposed (gpointer data,
+                                  GObject *where_the_object_was)
+{
+  /* weak notifies run during dispose, before the qdata is destroyed */
+  panel_properties_bindings_write (where_the_object_was);
+}
+
+
+
+static void
+panel_properties_plugin_removed (XfcePanelPlugin *plugin)
+{
+  PanelPropertyBinding *binding;
+  const gchar *property_base;
+  gsize len;
+  GList *li, *lnext;
+
+  /* the panel resets the plugin properties, so do not write them
+   * back to the channel afterwards */
+  property_base = xfce_panel_plugin_get_property_base (plugin);
+  len = strlen (property_base);
+  for (li = pending_bindings.head; li != NULL; li = lnext)
+    {
+      lnext = li->next;
+      binding = li->data;
+      if (strncmp (binding->xfconf_property, property_base, len) == 0
+          && binding->xfconf_property[len] == '/')
+        panel_properties_binding_dequeue (binding);
+    }
+}
+
 
-  g_value_unset (&value);
+
+static PanelPropertyBinding *
+panel_properties_binding_new (XfconfChannel *channel,
+                              const gchar *xfconf_property,
+                              GType xfconf_property_type,
+                              GObject *object,
+                              GParamSpec *pspec)
+{
+  PanelPropertyBinding *binding;
+  gchar *signal_name;
+  GSList *bindings;
+
+  binding = g_slice_new0 (PanelPropertyBinding);
+  binding->channel = g_object_ref (channel);
+  binding->xfconf_property = g_strdup (xfconf_property);
+  binding->xfconf_property_type = xfconf_property_type;
+  binding->object = object;
+  binding->pspec = pspec;
+
+  signal_name = g_strconcat ("property-changed::", xfconf_property, NULL);
+  binding->channel_handler_id = g_signal_connect (G_OBJECT (channel), signal_name,
+                                                  G_CALLBACK (panel_properties_channel_changed), binding);
+  g_free (signal_name);
+
+  signal_name = g_strconcat ("notify::", pspec->name, NULL);
+  binding->object_handler_id = g_signal_connect (object, signal_name,
+                                                 G_CALLBACK (panel_properties_object_notify), binding);
+  g_free (signal_name);
+
+  /* attach the binding to the object */
+  if (G_UNLIKELY (bindings_quark == 0))
+    bindings_quark = g_quark_from_static_string ("panel-properties-bindings");
+  bindings = g_object_steal_qdata (object, bindings_quark);
+  if (bindings == NULL)
+    {
+      g_object_weak_ref (object, panel_properties_object_disposed, NULL);
+      if (XFCE_IS_PANEL_PLUGIN (object))
+        g_signal_connect (object, "removed", G_CALLBACK (panel_properties_plugin_removed), NULL);
+    }
+  bindings = g_slist_prepend (bindings, binding);
+  g_object_set_qdata_full (object, bindings_quark, bindings, panel_properties_bindings_free);
+
+  return binding;
 }
 
 
@@ -78,7 +420,7 @@ panel_properties_get_channel (GObject *object_for_weak_ref)
     }
 
   channel = xfconf_channel_get (XFCE_PANEL_CHANNEL_NAME);
-  g_object_weak_ref (object_for_weak_ref, (GWeakNotify) xfconf_shutdown, NULL);
+  g_object_weak_ref (object_for_weak_ref, (GWeakNotify) panel_properties_shutdown, NULL);
 
   return channel;
 }
@@ -93,7 +435,13 @@ panel_properties_bind (XfconfChannel *channel,
                        gboolean save_properties)
 {
   const PanelProperty *prop;
+  PanelPropertyBinding *binding;
+  GParamSpec *pspec;
+  GHashTable *values = NULL;
+  const GValue *value;
+  GValue single_value = G_VALUE_INIT;
   gchar *property;
+  guint n_properties = 0;
 
   panel_return_if_fail (channel == NULL || XFCONF_IS_CHANNEL (channel));
   panel_return_if_fail (G_IS_OBJECT (object));
@@ -104,21 +452,59 @@ panel_properties_bind (XfconfChannel *channel,
     channel = panel_properties_get_channel (object);
   panel_return_if_fail (channel != NULL);
 
+  for (prop = properties; prop->property != NULL; prop++)
+    n_properties++;
+
+  /* fetch all the values below the property base with a single request, unless
+   * there is only one property, the base can contain a lot more properties then */
+  if (!save_properties && n_properties > 1)
+    {
+      values = xfconf_channel_get_properties (channel, property_base);
+      n_requests_saved += n_properties - 1;
+
+      panel_debug_filtered (PANEL_DEBUG_XFCONF, "%s: fetched %u properties in 1 request, "
+                                                "%u requests saved in total",
+                            property_base, n_properties, n_requests_saved);
+    }
+
   /* walk the properties array */
   for (prop = properties; prop->property != NULL; prop++)
     {
+      pspec = g_object_class_find_property (G_OBJECT_GET_CLASS (object), prop->property);
+      if (G_UNLIKELY (pspec == NULL))
+        {
+          g_critical ("Object %s has no property \"%s\" to bind",
+                      G_OBJECT_TYPE_NAME (object), prop->property);
+          continue;
+        }
+
       property = g_strconcat (property_base, "/", prop->property, NULL);
+      binding = panel_properties_binding_new (channel, property, prop->type, object, pspec);
 
       if (save_properties)
-        panel_properties_store_value (channel, property, prop->type, object, prop->property);
-
-      if (G_LIKELY (prop->type != GDK_TYPE_RGBA))
-        xfconf_g_property_bind (channel, property, prop->type, object, prop->property);
-      else
-        xfconf_g_property_bind_gdkrgba (channel, property, object, prop->property);
+        {
+          /* write the object value to the channel */
+          panel_properties_binding_queue (binding);
+        }
+      else if (values != NULL)
+        {
+          /* apply the value from the channel to the object */
+          value = g_hash_table_lookup (values, property);
+          if (value != NULL)
+            panel_properties_binding_apply (binding, value);
+        }
+      else if (n_properties == 1
+               && xfconf_channel_get_property (channel, property, &single_value))
+        {
+          panel_properties_binding_apply (binding, &single_value);
+          g_value_unset (&single_value);
+        }
 
       g_free (property);
     }
+
+  if (values != NULL)
+    g_hash_table_destroy (values);
 }
 
 
@@ -126,5 +512,29 @@ panel_properties_bind (XfconfChannel *channel,
 void
 panel_properties_unbind (GObject *object)
 {
-  xfconf_g_property_unbind_all (object);
+  panel_return_if_fail (G_IS_OBJECT (object));
+
+  if (bindings_quark == 0 || g_object_get_qdata (object, bindings_quark) == NULL)
+    return;
+
+  /* write pending values and disconnect all the bindings */
+  panel_properties_bindings_write (object);
+  g_object_weak_unref (object, panel_properties_object_disposed, NULL);
+  g_signal_handlers_disconnect_by_func (object, panel_properties_plugin_removed, NULL);
+  g_object_set_qdata (object, bindings_quark, NULL);
+}
+
+
+
+void
+panel_properties_shutdown (void)
+{
+  /* write all pending values while xfconf is still running */
+  if (pending_flush_id != 0)
+    {
+      g_source_remove (pending_flush_id);
+      panel_properties_flush (NULL);
+    }
+
+  xfconf_shutdown ();
 }
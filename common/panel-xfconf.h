@@ -44,6 +44,9 @@ panel_properties_bind (XfconfChannel *channel,
 void
 panel_properties_unbind (GObject *object);
 
+void
+panel_properties_shutdown (void);
+
 G_END_DECLS
 
 #endif /* !__PANEL_XFCONF_H__ */
@@ -139,7 +139,8 @@ enum
   PLUGIN_EXIT_CHECK_FAILED,
   PLUGIN_EXIT_NO_PROVIDER,
   PLUGIN_EXIT_NAME_LOST,
-  PLUGIN_EXIT_SUCCESS_AND_RESTART
+  PLUGIN_EXIT_SUCCESS_AND_RESTART,
+  PLUGIN_EXIT_NOT_HOSTABLE
 };
 
 /* argument handling in plugin and wrapper */
@@ -29,6 +29,7 @@
 #include "common/panel-dbus.h"
 #include "common/panel-debug.h"
 #include "common/panel-private.h"
+#include "common/panel-xfconf.h"
 #include "libxfce4panel/libxfce4panel.h"
 
 #include <gio/gio.h>
@@ -406,7 +407,8 @@ launch_panel:
       g_spawn_command_line_async (argv[0], NULL);
     }
 
-  xfconf_shutdown ();
+  /* write pending bound properties before xfconf goes down */
+  panel_properties_shutdown ();
 
   return EXIT_SUCCESS;
 
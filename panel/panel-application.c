@@ -23,8 +23,10 @@
 #include "panel-item-dialog.h"
 #include "panel-itembar.h"
 #include "panel-module-factory.h"
+#include "panel-plugin-external-host.h"
 #include "panel-plugin-external.h"
 #include "panel-preferences-dialog.h"
+#include "panel-trace.h"
 
 #include "common/panel-debug.h"
 #include "common/panel-private.h"
@@ -36,6 +38,7 @@
 #include <glib/gstdio.h>
 #include <libxfce4ui/libxfce4ui.h>
 #include <libxfce4util/libxfce4util.h>
+#include <libxfce4windowing/libxfce4windowing.h>
 #include <xfconf/xfconf.h>
 
 #ifdef HAVE_GTK_LAYER_SHELL
@@ -96,6 +99,10 @@ panel_application_drag_leave (GtkWidget *window,
                               GdkDragContext *context,
                               guint drag_time,
                               PanelApplication *application);
+static void
+panel_application_active_window_changed (XfwScreen *screen,
+                                         XfwWindow *previous_window,
+                                         PanelApplication *application);
 
 
 
@@ -124,6 +131,10 @@ struct _PanelApplication
   /* autohide count at application level */
   gint autohide_block;
 
+  /* active window, tracked once for all the panels */
+  XfwScreen *xfw_screen;
+  XfwWindow *active_window;
+
 #ifdef ENABLE_X11
   guint wait_for_wm_timeout_id;
 #endif
@@ -148,6 +159,15 @@ typedef struct
 } WaitForWM;
 #endif
 
+typedef struct
+{
+  PanelWindow *window;
+  gchar *name;
+  gint unique_id;
+  guint external : 1;
+  guint inserted : 1;
+} LoadItem;
+
 enum
 {
   TARGET_PLUGIN_NAME,
@@ -224,6 +244,13 @@ panel_application_init (PanelApplication *application)
   /* get a factory reference so it never unloads */
   application->factory = panel_module_factory_get ();
 
+  /* track the active window for intellihide */
+  application->xfw_screen = xfw_screen_get_default ();
+  application->active_window = NULL;
+  panel_application_active_window_changed (application->xfw_screen, NULL, application);
+  g_signal_connect (G_OBJECT (application->xfw_screen), "active-window-changed",
+                    G_CALLBACK (panel_application_active_window_changed), application);
+
 #ifdef ENABLE_WAYLAND
   /* warn the user about restricted features on Wayland */
   if (WINDOWING_IS_WAYLAND ())
@@ -260,6 +287,12 @@ panel_application_finalize (GObject *object)
     g_source_remove (application->wait_for_wm_timeout_id);
 #endif
 
+  /* stop tracking the active window */
+  if (application->active_window != NULL)
+    g_signal_handlers_disconnect_by_data (application->active_window, application);
+  g_signal_handlers_disconnect_by_data (application->xfw_screen, application);
+  g_object_unref (application->xfw_screen);
+
   /* destroy all panels */
   g_slist_free_full (application->windows, (GDestroyNotify) gtk_widget_destroy);
 
@@ -386,6 +419,9 @@ panel_application_plugin_delete_config (PanelApplication *application,
   panel_return_if_fail (!xfce_str_is_empty (name));
   panel_return_if_fail (unique_id != -1);
 
+  /* the id can be reused by a new plugin */
+  panel_plugin_external_host_set_group (unique_id, NULL);
+
   /* remove the xfconf property */
   property = g_strdup_printf (PLUGINS_PROPERTY_BASE, unique_id);
   if (xfconf_channel_has_property (application->xfconf, property))
@@ -405,29 +441,93 @@ panel_application_plugin_delete_config (PanelApplication *application,
 
 
 
+static void
+panel_application_load_item_free (gpointer data)
+{
+  LoadItem *item = data;
+
+  g_free (item->name);
+  g_slice_free (LoadItem, item);
+}
+
+
+
+static gboolean
+panel_application_load_item (PanelApplication *application,
+                             LoadItem *item,
+                             gint position,
+                             gboolean *save_changed_ids)
+{
+  /* append the plugin to the panel */
+  if (item->unique_id >= 1 && item->name != NULL
+      && panel_application_plugin_insert (application, item->window,
+                                          item->name, item->unique_id, NULL, position))
+    {
+      item->inserted = TRUE;
+      return TRUE;
+    }
+
+  /* plugin could not be loaded, ask the user what to do */
+  if (panel_application_remove_plugin_dialog (GTK_WINDOW (item->window), item->name))
+    {
+      *save_changed_ids = TRUE;
+      panel_application_plugin_delete_config (application, item->name, item->unique_id);
+      return TRUE;
+    }
+
+  /* stop loading, the user wants to quit */
+  *save_changed_ids = FALSE;
+  gtk_main_quit ();
+
+  return FALSE;
+}
+
+
+
+static const GValue *
+panel_application_lookup_property (GHashTable *properties,
+                                   const gchar *property)
+{
+  return properties != NULL ? g_hash_table_lookup (properties, property) : NULL;
+}
+
+
+
 static void
 panel_application_load_real (PanelApplication *application)
 {
   PanelWindow *window;
   guint i, j, n_panels;
   gchar buf[50];
-  gchar *name;
   gint unique_id;
   GdkScreen *screen;
   GPtrArray *array;
   const GValue *value;
-  gchar *output_name;
+  const gchar *output_name;
   gint screen_num;
   GdkDisplay *display;
   GValue val = G_VALUE_INIT;
   GPtrArray *panels;
   gint panel_id;
   gboolean save_changed_ids = FALSE;
+  GHashTable *panel_properties, *plugin_properties;
+  GPtrArray *items;
+  LoadItem *item;
+  gboolean proceed = TRUE;
+  gint position;
+  gint64 trace_begin;
 
   panel_return_if_fail (PANEL_IS_APPLICATION (application));
   panel_return_if_fail (XFCONF_IS_CHANNEL (application->xfconf));
 
+  trace_begin = panel_trace_begin ();
   display = gdk_display_get_default ();
+  items = g_ptr_array_new_with_free_func (panel_application_load_item_free);
+
+  /* fetch the panel configuration and plugin names in two round trips,
+   * instead of a couple of requests for each panel and plugin */
+  panel_properties = xfconf_channel_get_properties (application->xfconf, PANELS_PROPERTY_PREFIX);
+  plugin_properties = xfconf_channel_get_properties (application->xfconf, PLUGINS_PROPERTY_PREFIX);
 
   if (xfconf_channel_get_property (application->xfconf, PANELS_PROPERTY_PREFIX, &val)
       && (G_VALUE_HOLDS_UINT (&val)
@@ -465,7 +565,8 @@ panel_application_load_real (PanelApplication *application)
 
           /* start the panel directly on the correct screen */
           g_snprintf (buf, sizeof (buf), PANELS_PROPERTY_BASE "/output-name", panel_id);
-          output_name = xfconf_channel_get_string (application->xfconf, buf, NULL);
+          value = panel_application_lookup_property (panel_properties, buf);
+          output_name = value != NULL && G_VALUE_HOLDS_STRING (value) ? g_value_get_string (value) : NULL;
           if (output_name != NULL
               && strncmp (output_name, "screen-", 7) == 0
               && sscanf (output_name, "screen-%d", &screen_num) == 1)
@@ -473,17 +574,17 @@ panel_application_load_real (PanelApplication *application)
               if (screen_num < 1)
                 screen = gdk_display_get_default_screen (display);
             }
-          g_free (output_name);
 
           /* create a new window */
           window = panel_application_new_window (application, screen, panel_id, FALSE);
 
           /* walk all the plugins on the panel */
           g_snprintf (buf, sizeof (buf), PLUGIN_IDS_PROPERTY_BASE, panel_id);
-          array = xfconf_channel_get_arrayv (application->xfconf, buf);
-          if (array == NULL)
+          value = panel_application_lookup_property (panel_properties, buf);
+          if (value == NULL || !G_VALUE_HOLDS (value, G_TYPE_PTR_ARRAY))
             continue;
 
+          array = g_value_get_boxed (value);
           for (j = 0; j < array->len; j++)
             {
               /* get the plugin id */
@@ -491,45 +592,80 @@ panel_application_load_real (PanelApplication *application)
               panel_assert (value != NULL);
               unique_id = g_value_get_int (value);
 
+              item = g_slice_new0 (LoadItem);
+              item->window = window;
+              item->unique_id = unique_id;
+
               /* get the plugin name */
               g_snprintf (buf, sizeof (buf), PLUGINS_PROPERTY_BASE, unique_id);
-              name = xfconf_channel_get_string (application->xfconf, buf, NULL);
+              value = panel_application_lookup_property (plugin_properties, buf);
+              if (value != NULL && G_VALUE_HOLDS_STRING (value))
+                {
+                  item->name = g_value_dup_string (value);
+                  item->external = panel_module_factory_get_run_mode (application->factory, item->name)
+                                   == PANEL_MODULE_RUN_MODE_EXTERNAL;
+                }
 
-              /* append the plugin to the panel */
-              if (unique_id < 1 || name == NULL
-                  || !panel_application_plugin_insert (application, window,
-                                                       name, unique_id, NULL, -1))
+              /* plugins with the same host group share a wrapper process */
+              if (item->external)
                 {
-                  /* plugin could not be loaded, ask the user what to do */
-                  if (panel_application_remove_plugin_dialog (GTK_WINDOW (window), name))
-                    {
-                      save_changed_ids = TRUE;
-                      panel_application_plugin_delete_config (application, name, unique_id);
-                    }
-                  else
-                    {
-                      save_changed_ids = FALSE;
-                      j = array->len;
-                      gtk_main_quit ();
-                    }
+                  g_snprintf (buf, sizeof (buf), PLUGINS_PROPERTY_BASE "/host-group", unique_id);
+                  value = panel_application_lookup_property (plugin_properties, buf);
+                  if (value != NULL && G_VALUE_HOLDS_STRING (value))
+                    panel_plugin_external_host_set_group (unique_id, g_value_get_string (value));
                 }
 
-              g_free (name);
+              g_ptr_array_add (items, item);
             }
-
-          xfconf_array_free (array);
         }
 
       /* free xfconf array or uint */
       g_value_unset (&val);
     }
 
+  panel_debug (PANEL_DEBUG_APPLICATION, "loading %u plugins", items->len);
+
+  /* insert the external plugins first, so their wrappers are already
+   * starting up while the internal plugins are constructed */
+  for (i = 0; proceed && i < items->len; i++)
+    {
+      item = g_ptr_array_index (items, i);
+      if (item->external)
+        proceed = panel_application_load_item (application, item, -1, &save_changed_ids);
+    }
+
+  /* insert the internal plugins at their position between the external plugins */
+  for (i = 0, position = 0, window = NULL; proceed && i < items->len; i++)
+    {
+      item = g_ptr_array_index (items, i);
+      if (item->window != window)
+        {
+          window = item->window;
+          position = 0;
+        }
+
+      if (!item->external)
+        proceed = panel_application_load_item (application, item, position, &save_changed_ids);
+
+      if (item->inserted)
+        position++;
+    }
+
+  g_ptr_array_unref (items);
+
+  if (panel_properties != NULL)
+    g_hash_table_destroy (panel_properties);
+  if (plugin_properties != NULL)
+    g_hash_table_destroy (plugin_properties);
+
   /* create empty window if everything else failed */
   if (G_UNLIKELY (application->windows == NULL))
     panel_application_new_window (application, NULL, -1, TRUE);
 
   if (save_changed_ids)
     panel_application_save (application, SAVE_PLUGIN_IDS);
+
+  panel_trace_end (trace_begin, "application", "load", NULL, -1);
 }
 
 
@@ -1205,6 +1341,93 @@ panel_application_drag_leave (GtkWidget *window,
 
 
 
+static void
+panel_application_active_window_geometry_changed (XfwWindow *active_window,
+                                                  PanelApplication *application)
+{
+  GSList *li;
+
+  panel_return_if_fail (XFW_IS_WINDOW (active_window));
+  panel_return_if_fail (PANEL_IS_APPLICATION (application));
+
+  for (li = application->windows; li != NULL; li = li->next)
+    panel_window_active_window_geometry_changed (li->data);
+}
+
+
+
+static void
+panel_application_active_window_state_changed (XfwWindow *active_window,
+                                               XfwWindowState changed,
+                                               XfwWindowState new,
+                                               PanelApplication *application)
+{
+  GList *monitors = NULL;
+  GSList *li;
+
+  panel_return_if_fail (XFW_IS_WINDOW (active_window));
+  panel_return_if_fail (PANEL_IS_APPLICATION (application));
+
+  /* the monitor set is only needed for the maximized state on Wayland */
+  if (!WINDOWING_IS_X11 ())
+    monitors = xfw_window_get_monitors (active_window);
+
+  for (li = application->windows; li != NULL; li = li->next)
+    panel_window_active_window_state_changed (li->data, changed, new, monitors);
+}
+
+
+
+static void
+panel_application_active_window_monitors (XfwWindow *active_window,
+                                          GParamSpec *pspec,
+                                          PanelApplication *application)
+{
+  panel_application_active_window_state_changed (active_window, 0,
+                                                 xfw_window_get_state (active_window),
+                                                 application);
+}
+
+
+
+static void
+panel_application_active_window_changed (XfwScreen *screen,
+                                         XfwWindow *previous_window,
+                                         PanelApplication *application)
+{
+  XfwWindow *active_window;
+  GSList *li;
+
+  panel_return_if_fail (XFW_IS_SCREEN (screen));
+  panel_return_if_fail (PANEL_IS_APPLICATION (application));
+
+  /* disconnect from previously active window */
+  if (application->active_window != NULL)
+    g_signal_handlers_disconnect_by_data (application->active_window, application);
+
+  /* obtain new active window from the screen */
+  active_window = xfw_screen_get_active_window (screen);
+  application->active_window = active_window;
+
+  /* connect to the new window */
+  if (active_window != NULL)
+    {
+      g_signal_connect (G_OBJECT (active_window), "geometry-changed",
+                        G_CALLBACK (panel_application_active_window_geometry_changed), application);
+      g_signal_connect (G_OBJECT (active_window), "state-changed",
+                        G_CALLBACK (panel_application_active_window_state_changed), application);
+      if (gtk_layer_is_supported ())
+        g_signal_connect (G_OBJECT (active_window), "notify::monitors",
+                          G_CALLBACK (panel_application_active_window_monitors), application);
+    }
+
+  /* update the active window used by the panels for the autohide feature */
+  for (li = application->windows; li != NULL; li = li->next)
+    panel_window_set_active_window (li->data, active_window);
+}
+
+
+
 static gboolean
 panel_application_window_id_exists (PanelApplication *application,
                                     gint id)
@@ -1574,6 +1797,7 @@ panel_application_new_window (PanelApplication *application,
 
   /* add the window to internal list */
   application->windows = g_slist_append (application->windows, window);
+  panel_window_set_active_window (PANEL_WINDOW (window), application->active_window);
 
   if (new_window)
     {
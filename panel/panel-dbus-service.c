@@ -22,6 +22,7 @@
 #include "panel-item-dialog.h"
 #include "panel-module-factory.h"
 #include "panel-preferences-dialog.h"
+#include "panel-trace.h"
 
 #include "common/panel-dbus.h"
 #include "common/panel-private.h"
@@ -70,6 +71,10 @@ panel_dbus_service_plugin_event (XfcePanelExportedService *skeleton,
                                  GVariant *variant,
                                  PanelDBusService *service);
 static gboolean
+panel_dbus_service_get_trace (XfcePanelExportedService *skeleton,
+                              GDBusMethodInvocation *invocation,
+                              PanelDBusService *service);
+static gboolean
 panel_dbus_service_terminate (XfcePanelExportedService *skeleton,
                               GDBusMethodInvocation *invocation,
                               gboolean restart,
@@ -139,6 +144,8 @@ panel_dbus_service_init (PanelDBusService *service)
                             G_CALLBACK (panel_dbus_service_display_items_dialog), service);
           g_signal_connect (service, "handle-display-preferences-dialog",
                             G_CALLBACK (panel_dbus_service_display_preferences_dialog), service);
+          g_signal_connect (service, "handle-get-trace",
+                            G_CALLBACK (panel_dbus_service_get_trace), service);
           g_signal_connect (service, "handle-plugin-event",
                             G_CALLBACK (panel_dbus_service_plugin_event), service);
           g_signal_connect (service, "handle-save",
@@ -347,6 +354,24 @@ panel_dbus_service_plugin_event (XfcePanelExportedService *skeleton,
 
 
 
+static gboolean
+panel_dbus_service_get_trace (XfcePanelExportedService *skeleton,
+                              GDBusMethodInvocation *invocation,
+                              PanelDBusService *service)
+{
+  gchar *trace;
+
+  panel_return_val_if_fail (PANEL_IS_DBUS_SERVICE (service), FALSE);
+
+  trace = panel_trace_to_json ();
+  xfce_panel_exported_service_complete_get_trace (skeleton, invocation, trace);
+  g_free (trace);
+
+  return TRUE;
+}
+
+
+
 static gboolean
 panel_dbus_service_terminate (XfcePanelExportedService *skeleton,
                               GDBusMethodInvocation *invocation,
@@ -18,6 +18,7 @@
  */
 
 #include "panel-itembar.h"
+#include "panel-trace.h"
 #include "panel-window.h"
 
 #include "common/panel-debug.h"
@@ -51,6 +52,8 @@ panel_itembar_get_property (GObject *object,
 static void
 panel_itembar_finalize (GObject *object);
 static void
+panel_itembar_queue_resize (PanelItembar *itembar);
+static void
 panel_itembar_get_preferred_length (GtkWidget *widget,
                                     gint *minimum_length,
                                     gint *natural_length);
@@ -103,7 +106,21 @@ struct _PanelItembar
 {
   GtkContainer __parent__;
 
-  GSList *children;
+  /* children in packing order, with a NULL slot for the dnd highlight */
+  GPtrArray *children;
+  GHashTable *widgets;
+
+  /* start of each slot along the itembar, from the last allocation */
+  GArray *offsets;
+
+  /* totals of the last measure pass, the requests of the
+   * children themselves are cached in PanelItembarChild */
+  gboolean measured;
+  gint natural_len;
+  gint minimum_len;
+  gint fixed_len;
+  gint expand_len;
+  gint shrink_len;
 
   /* some properties we clone from the panel window */
   XfcePanelPluginMode mode;
@@ -114,6 +131,7 @@ struct _PanelItembar
 
   /* dnd support */
   gint highlight_index;
+  guint highlight_slot;
   gint highlight_x, highlight_y, highlight_length;
   gboolean highlight_small;
 };
@@ -131,6 +149,11 @@ struct _PanelItembarChild
   GtkWidget *widget;
   ChildOptions option;
   gint row;
+  guint index;
+
+  /* cached size request along the itembar */
+  gint len;
+  gint len_min;
 };
 
 enum
@@ -264,13 +287,17 @@ panel_itembar_class_init (PanelItembarClass *klass)
 static void
 panel_itembar_init (PanelItembar *itembar)
 {
-  itembar->children = NULL;
+  itembar->children = g_ptr_array_new ();
+  itembar->widgets = g_hash_table_new (g_direct_hash, g_direct_equal);
+  itembar->offsets = g_array_new (FALSE, FALSE, sizeof (gint));
+  itembar->measured = FALSE;
   itembar->mode = XFCE_PANEL_PLUGIN_MODE_HORIZONTAL;
   itembar->size = 30;
   itembar->icon_size = 0;
   itembar->dark_mode = FALSE;
   itembar->nrows = 1;
   itembar->highlight_index = -1;
+  itembar->highlight_slot = 0;
   itembar->highlight_length = -1;
 
   gtk_widget_set_has_window (GTK_WIDGET (itembar), FALSE);
@@ -315,7 +342,7 @@ panel_itembar_set_property (GObject *object,
       break;
     }
 
-  gtk_widget_queue_resize (GTK_WIDGET (itembar));
+  panel_itembar_queue_resize (itembar);
 }
 
 
@@ -339,47 +366,89 @@ panel_itembar_get_property (GObject *object,
 static void
 panel_itembar_finalize (GObject *object)
 {
-  panel_return_if_fail (PANEL_ITEMBAR (object)->children == NULL);
+  PanelItembar *itembar = PANEL_ITEMBAR (object);
+
+  panel_return_if_fail (itembar->children->len == 0);
+
+  g_ptr_array_free (itembar->children, TRUE);
+  g_hash_table_destroy (itembar->widgets);
+  g_array_free (itembar->offsets, TRUE);
 
   (*G_OBJECT_CLASS (panel_itembar_parent_class)->finalize) (object);
 }
 
+
+
 static void
-panel_itembar_get_preferred_length (GtkWidget *widget,
-                                    gint *minimum_length,
-                                    gint *natural_length)
+panel_itembar_queue_resize (PanelItembar *itembar)
+{
+  /* the cached child requests and offsets are outdated */
+  itembar->measured = FALSE;
+  g_array_set_size (itembar->offsets, 0);
+
+  gtk_widget_queue_resize (GTK_WIDGET (itembar));
+}
+
+
+
+static void
+panel_itembar_update_indices (PanelItembar *itembar,
+                              guint from)
+{
+  PanelItembarChild *child;
+  guint i;
+
+  for (i = from; i < itembar->children->len; i++)
+    {
+      child = g_ptr_array_index (itembar->children, i);
+      if (child != NULL)
+        child->index = i;
+    }
+}
+
+
+
+static void
+panel_itembar_measure (PanelItembar *itembar)
 {
-  PanelItembar *itembar = PANEL_ITEMBAR (widget);
-  GSList *li;
   PanelItembarChild *child;
-  gint row_max_size, row_max_size_min;
+  gint row_max_size, row_max_size_min, row_max_alloc;
   gint col_count;
-  gint total_len, total_len_min;
   gint child_len, child_len_min;
+  guint i;
 
-  /* total length we request */
-  total_len = 0;
-  total_len_min = 0;
+  itembar->natural_len = 0;
+  itembar->minimum_len = 0;
+  itembar->fixed_len = 0;
+  itembar->expand_len = 0;
+  itembar->shrink_len = 0;
 
-  /* counter for small child packing */
+  /* counters for small child packing */
   row_max_size = 0;
   row_max_size_min = 0;
+  row_max_alloc = 0;
   col_count = 0;
 
-  for (li = itembar->children; li != NULL; li = li->next)
+  for (i = 0; i < itembar->children->len; i++)
     {
-      child = li->data;
+      child = g_ptr_array_index (itembar->children, i);
 
       if (G_LIKELY (child != NULL))
         {
           if (!gtk_widget_get_visible (child->widget))
             continue;
 
-          /* get the child's size request */
+          /* get the child's size request, gtk answers this from its own request
+           * cache for children that did not queue a resize */
           if (IS_HORIZONTAL (itembar))
             gtk_widget_get_preferred_width_for_height (child->widget, itembar->size * itembar->nrows, &child_len_min, &child_len);
           else
             gtk_widget_get_preferred_height_for_width (child->widget, itembar->size * itembar->nrows, &child_len_min, &child_len);
+
+          /* cache the request for the allocation */
+          child->len = child_len;
+          child->len_min = child_len_min;
+
           /* check if the small child fits in a row */
           if (child->option == CHILD_OPTION_SMALL
               && itembar->nrows > 1)
@@ -388,45 +457,83 @@ panel_itembar_get_preferred_length (GtkWidget *widget,
                * so add the difference between the largest child in this column */
               if (child_len > row_max_size)
                 {
-                  total_len += child_len - row_max_size;
-                  total_len_min += child_len_min - row_max_size_min;
+                  itembar->natural_len += child_len - row_max_size;
+                  itembar->minimum_len += child_len_min - row_max_size_min;
                   row_max_size = child_len;
                   row_max_size_min = child_len_min;
                 }
 
+              /* the allocation gives every child at least 1 pixel */
+              if (MAX (child_len, 1) > row_max_alloc)
+                {
+                  itembar->fixed_len += MAX (child_len, 1) - row_max_alloc;
+                  row_max_alloc = MAX (child_len, 1);
+                }
+
               /* reset to new row if all columns are filled */
               if (++col_count >= itembar->nrows)
                 {
                   col_count = 0;
                   row_max_size = 0;
                   row_max_size_min = 0;
+                  row_max_alloc = 0;
                 }
             }
           else /* expanding or normal item */
             {
-              total_len += child_len;
-              total_len_min += child_len_min;
+              itembar->natural_len += child_len;
+              itembar->minimum_len += child_len_min;
 
               /* reset column packing */
               col_count = 0;
               row_max_size = 0;
               row_max_size_min = 0;
+              row_max_alloc = 0;
+
+              /* totals for sharing the length between expanding and shrinking children */
+              if (G_UNLIKELY (child->option == CHILD_OPTION_EXPAND))
+                {
+                  itembar->expand_len += MAX (child_len, 1);
+                }
+              else
+                {
+                  itembar->fixed_len += MAX (child_len, 1);
+
+                  if (MAX (child_len_min, 1) < MAX (child_len, 1))
+                    itembar->shrink_len += MAX (child_len, 1) - MAX (child_len_min, 1);
+                }
             }
         }
       else
         {
           /* this noop item is the dnd position */
-          total_len += HIGHLIGHT_SIZE;
-          total_len_min += HIGHLIGHT_SIZE;
+          itembar->natural_len += HIGHLIGHT_SIZE;
+          itembar->minimum_len += HIGHLIGHT_SIZE;
+          itembar->fixed_len += HIGHLIGHT_SIZE;
         }
     }
 
+  itembar->measured = TRUE;
+}
+
+
+
+static void
+panel_itembar_get_preferred_length (GtkWidget *widget,
+                                    gint *minimum_length,
+                                    gint *natural_length)
+{
+  PanelItembar *itembar = PANEL_ITEMBAR (widget);
+
+  /* gtk only asks again when the itembar or one of its children queued a resize */
+  panel_itembar_measure (itembar);
+
   /* return the total size */
   if (natural_length != NULL)
-    *natural_length = total_len;
+    *natural_length = itembar->natural_len;
 
   if (minimum_length != NULL)
-    *minimum_length = total_len_min;
+    *minimum_length = itembar->minimum_len;
 }
 
 
@@ -488,8 +595,7 @@ panel_itembar_size_allocate (GtkWidget *widget,
                              GtkAllocation *allocation)
 {
   PanelItembar *itembar = PANEL_ITEMBAR (widget);
-  GSList *lp, *ltemp;
-  PanelItembarChild *child;
+  PanelItembarChild *child, *next;
   GtkAllocation child_alloc;
   gint expand_len_avail, expand_len_req;
   gint shrink_len_avail, shrink_len_req;
@@ -502,11 +608,16 @@ panel_itembar_size_allocate (GtkWidget *widget,
   gint row_max_size;
   gint col_count;
   gint rows_size;
+  gint *offset;
+  guint i;
+  gint64 trace_begin;
 
 #define CHILD_MIN_ALLOC_LEN(child_len) \
   if (G_UNLIKELY ((child_len) < 1)) \
     (child_len) = 1;
 
+  trace_begin = panel_trace_begin ();
+
   /* the maximum allocation is limited by that of the
    * panel window, so take over the assigned allocation */
   gtk_widget_set_allocation (widget, allocation);
@@ -516,79 +627,19 @@ panel_itembar_size_allocate (GtkWidget *widget,
   else
     itembar_len = allocation->height;
 
+  /* the children are measured before the itembar is allocated, unless
+   * only the allocation of the panel changed */
+  if (G_UNLIKELY (!itembar->measured))
+    panel_itembar_measure (itembar);
+
   /* init the remaining space for expanding plugins */
-  expand_len_avail = itembar_len;
-  expand_len_req = 0;
+  expand_len_avail = itembar_len - itembar->fixed_len;
+  expand_len_req = itembar->expand_len;
 
   /* init the total size of shrinking plugins */
-  shrink_len_avail = 0;
+  shrink_len_avail = itembar->shrink_len;
   shrink_len_req = 0;
 
-  /* init counters for small child packing */
-  row_max_size = 0;
-  col_count = 0;
-
-  /* get information about the expandable lengths */
-  for (lp = itembar->children; lp != NULL; lp = lp->next)
-    {
-      child = lp->data;
-      if (G_LIKELY (child != NULL))
-        {
-          if (!gtk_widget_get_visible (child->widget))
-            continue;
-
-          if (IS_HORIZONTAL (itembar))
-            gtk_widget_get_preferred_width_for_height (child->widget, itembar->size * itembar->nrows, &child_len_min, &child_len);
-          else
-            gtk_widget_get_preferred_height_for_width (child->widget, itembar->size * itembar->nrows, &child_len_min, &child_len);
-
-          /* child will allocate at least 1 pixel */
-          CHILD_MIN_ALLOC_LEN (child_len);
-          CHILD_MIN_ALLOC_LEN (child_len_min);
-
-          if (G_UNLIKELY (child->option == CHILD_OPTION_SMALL
-                          && itembar->nrows > 1))
-            {
-              /* extract from the available space */
-              if (child_len > row_max_size)
-                {
-                  expand_len_avail -= child_len - row_max_size;
-                  row_max_size = child_len;
-                }
-
-              /* reset to new row if all columns are filled */
-              if (++col_count >= itembar->nrows)
-                {
-                  col_count = 0;
-                  row_max_size = 0;
-                }
-            }
-          else
-            {
-              /* reset column packing counters */
-              col_count = 0;
-              row_max_size = 0;
-
-              if (G_UNLIKELY (child->option == CHILD_OPTION_EXPAND))
-                {
-                  expand_len_req += child_len;
-                }
-              else
-                {
-                  expand_len_avail -= child_len;
-
-                  if (child_len_min < child_len)
-                    shrink_len_avail += (child_len - child_len_min);
-                }
-            }
-        }
-      else
-        {
-          /* dnd separator */
-          expand_len_avail -= HIGHLIGHT_SIZE;
-        }
-    }
-
   /* whether the expandable items fit on this row; we use this
    * as a fast-path when there are expanding items on a panel with
    * not really enough length to expand (ie. items make the panel grow,
@@ -615,17 +666,27 @@ panel_itembar_size_allocate (GtkWidget *widget,
   /* the size property stored in the itembar is that of a single row */
   rows_size = itembar->size * itembar->nrows;
 
+  /* offsets of the slots, hidden children and the highlight start where the
+   * previous slot starts so the table stays sorted */
+  g_array_set_size (itembar->offsets, itembar->children->len);
+
   /* allocate the children on this row */
-  for (lp = itembar->children; lp != NULL; lp = lp->next)
+  for (i = 0; i < itembar->children->len; i++)
     {
-      child = lp->data;
+      child = g_ptr_array_index (itembar->children, i);
+
+      offset = &g_array_index (itembar->offsets, gint, i);
+      if (i > 0)
+        *offset = *(offset - 1);
+      else
+        *offset = IS_HORIZONTAL (itembar) ? x_init : y_init;
 
       /* the highlight item for which we keep some spare space */
       if (G_UNLIKELY (child == NULL))
         {
-          ltemp = g_slist_next (lp);
-          itembar->highlight_small = col_count > 0 && ltemp != NULL && ltemp->data != NULL
-                                     && ((PanelItembarChild *) ltemp->data)->option == CHILD_OPTION_SMALL;
+          next = i + 1 < itembar->children->len ? g_ptr_array_index (itembar->children, i + 1) : NULL;
+          itembar->highlight_small = col_count > 0 && next != NULL
+                                     && next->option == CHILD_OPTION_SMALL;
 
           if (itembar->highlight_small)
             {
@@ -659,10 +720,8 @@ panel_itembar_size_allocate (GtkWidget *widget,
       if (!gtk_widget_get_visible (child->widget))
         continue;
 
-      if (IS_HORIZONTAL (itembar))
-        gtk_widget_get_preferred_width_for_height (child->widget, itembar->size * itembar->nrows, &child_len_min, &child_len);
-      else
-        gtk_widget_get_preferred_height_for_width (child->widget, itembar->size * itembar->nrows, &child_len_min, &child_len);
+      child_len = child->len;
+      child_len_min = child->len_min;
 
       if (G_UNLIKELY (!expand_children_fit && child->option == CHILD_OPTION_EXPAND))
         {
@@ -782,8 +841,12 @@ panel_itembar_size_allocate (GtkWidget *widget,
             }
         }
 
+      *offset = IS_HORIZONTAL (itembar) ? child_alloc.x : child_alloc.y;
+
       gtk_widget_size_allocate (child->widget, &child_alloc);
     }
+
+  panel_trace_end (trace_begin, "itembar", "size-allocate", NULL, -1);
 }
 
 
@@ -900,14 +963,18 @@ panel_itembar_remove (GtkContainer *container,
   panel_return_if_fail (PANEL_IS_ITEMBAR (itembar));
   panel_return_if_fail (GTK_IS_WIDGET (widget));
   panel_return_if_fail (gtk_widget_get_parent (widget) == GTK_WIDGET (container));
-  panel_return_if_fail (itembar->children != NULL);
+  panel_return_if_fail (itembar->children->len > 0);
 
   child = panel_itembar_get_child (itembar, widget);
   if (G_LIKELY (child != NULL))
     {
       GtkWidget **provider = g_new (GtkWidget *, 1);
 
-      itembar->children = g_slist_remove (itembar->children, child);
+      g_ptr_array_remove_index (itembar->children, child->index);
+      g_hash_table_remove (itembar->widgets, widget);
+      panel_itembar_update_indices (itembar, child->index);
+      if (itembar->highlight_index != -1 && itembar->highlight_slot > child->index)
+        itembar->highlight_slot--;
 
       *provider = widget;
       g_signal_connect (widget, "destroy", G_CALLBACK (gtk_widget_destroyed), provider);
@@ -917,7 +984,7 @@ panel_itembar_remove (GtkContainer *container,
 
       g_slice_free (PanelItembarChild, child);
 
-      gtk_widget_queue_resize (GTK_WIDGET (container));
+      panel_itembar_queue_resize (itembar);
 
       g_signal_emit (G_OBJECT (itembar), itembar_signals[CHANGED], 0);
     }
@@ -932,18 +999,22 @@ panel_itembar_forall (GtkContainer *container,
                       gpointer callback_data)
 {
   PanelItembar *itembar = PANEL_ITEMBAR (container);
-  GSList *children = itembar->children;
   PanelItembarChild *child;
+  guint i;
 
   panel_return_if_fail (PANEL_IS_ITEMBAR (container));
 
-  while (children != NULL)
+  for (i = 0; i < itembar->children->len;)
     {
-      child = children->data;
-      children = g_slist_next (children);
+      child = g_ptr_array_index (itembar->children, i);
 
       if (G_LIKELY (child != NULL))
         (*callback) (child->widget, callback_data);
+
+      /* only advance if the callback did not remove the child */
+      if (i < itembar->children->len
+          && g_ptr_array_index (itembar->children, i) == child)
+        i++;
     }
 }
 
@@ -1004,7 +1075,7 @@ panel_itembar_set_child_property (GtkContainer *container,
 
   child->option = enable ? option : CHILD_OPTION_NONE;
 
-  gtk_widget_queue_resize (GTK_WIDGET (container));
+  panel_itembar_queue_resize (PANEL_ITEMBAR (container));
 }
 
 
@@ -1048,22 +1119,11 @@ static PanelItembarChild *
 panel_itembar_get_child (PanelItembar *itembar,
                          GtkWidget *widget)
 {
-  GSList *li;
-  PanelItembarChild *child;
-
   panel_return_val_if_fail (PANEL_IS_ITEMBAR (itembar), NULL);
   panel_return_val_if_fail (GTK_IS_WIDGET (widget), NULL);
   panel_return_val_if_fail (gtk_widget_get_parent (widget) == GTK_WIDGET (itembar), NULL);
 
-  for (li = itembar->children; li != NULL; li = g_slist_next (li))
-    {
-      child = li->data;
-      if (child != NULL
-          && child->widget == widget)
-        return child;
-    }
-
-  return NULL;
+  return g_hash_table_lookup (itembar->widgets, widget);
 }
 
 
@@ -1091,10 +1151,19 @@ panel_itembar_insert (PanelItembar *itembar,
   child->widget = widget;
   child->option = CHILD_OPTION_NONE;
 
-  itembar->children = g_slist_insert (itembar->children, child, position);
+  /* append for out of range positions, like g_slist_insert() */
+  if (position < 0 || (guint) position > itembar->children->len)
+    position = itembar->children->len;
+
+  g_ptr_array_insert (itembar->children, position, child);
+  g_hash_table_insert (itembar->widgets, widget, child);
+  panel_itembar_update_indices (itembar, position);
+  if (itembar->highlight_index != -1 && itembar->highlight_slot >= (guint) position)
+    itembar->highlight_slot++;
+
   gtk_widget_set_parent (widget, GTK_WIDGET (itembar));
 
-  gtk_widget_queue_resize (GTK_WIDGET (itembar));
+  panel_itembar_queue_resize (itembar);
   g_signal_emit (G_OBJECT (itembar), itembar_signals[CHANGED], 0);
 }
 
@@ -1106,6 +1175,7 @@ panel_itembar_reorder_child (PanelItembar *itembar,
                              gint position)
 {
   PanelItembarChild *child;
+  guint old_position;
 
   panel_return_if_fail (PANEL_IS_ITEMBAR (itembar));
   panel_return_if_fail (GTK_IS_WIDGET (widget));
@@ -1114,11 +1184,22 @@ panel_itembar_reorder_child (PanelItembar *itembar,
   child = panel_itembar_get_child (itembar, widget);
   if (G_LIKELY (child != NULL))
     {
-      /* move in the internal list */
-      itembar->children = g_slist_remove (itembar->children, child);
-      itembar->children = g_slist_insert (itembar->children, child, position);
+      /* move in the internal array */
+      old_position = child->index;
+      g_ptr_array_remove_index (itembar->children, old_position);
+      if (itembar->highlight_index != -1 && itembar->highlight_slot > old_position)
+        itembar->highlight_slot--;
+
+      if (position < 0 || (guint) position > itembar->children->len)
+        position = itembar->children->len;
+
+      g_ptr_array_insert (itembar->children, position, child);
+      if (itembar->highlight_index != -1 && itembar->highlight_slot >= (guint) position)
+        itembar->highlight_slot++;
+
+      panel_itembar_update_indices (itembar, MIN (old_position, (guint) position));
 
-      gtk_widget_queue_resize (GTK_WIDGET (itembar));
+      panel_itembar_queue_resize (itembar);
       g_signal_emit (G_OBJECT (itembar), itembar_signals[CHANGED], 0);
     }
 }
@@ -1129,25 +1210,17 @@ gint
 panel_itembar_get_child_index (PanelItembar *itembar,
                                GtkWidget *widget)
 {
-  GSList *li;
   PanelItembarChild *child;
-  gint idx;
 
   panel_return_val_if_fail (PANEL_IS_ITEMBAR (itembar), -1);
   panel_return_val_if_fail (GTK_IS_WIDGET (widget), -1);
   panel_return_val_if_fail (gtk_widget_get_parent (widget) == GTK_WIDGET (itembar), -1);
 
-  for (idx = 0, li = itembar->children; li != NULL; li = g_slist_next (li), idx++)
-    {
-      child = li->data;
-      if (G_UNLIKELY (child == NULL))
-        continue;
-
-      if (child->widget == widget)
-        return idx;
-    }
+  child = panel_itembar_get_child (itembar, widget);
+  if (G_UNLIKELY (child == NULL))
+    return -1;
 
-  return -1;
+  return child->index;
 }
 
 
@@ -1159,7 +1232,7 @@ panel_itembar_get_n_children (PanelItembar *itembar)
 
   panel_return_val_if_fail (PANEL_IS_ITEMBAR (itembar), 0);
 
-  n = g_slist_length (itembar->children);
+  n = itembar->children->len;
   if (G_UNLIKELY (itembar->highlight_index != -1))
     n--;
 
@@ -1168,15 +1241,54 @@ panel_itembar_get_n_children (PanelItembar *itembar)
 
 
 
+static guint
+panel_itembar_get_drop_slot (PanelItembar *itembar,
+                             gint x)
+{
+  PanelItembarChild *child;
+  GArray *offsets = itembar->offsets;
+  guint lower, upper, mid;
+
+  /* the offsets are outdated until the next allocation */
+  if (offsets->len != itembar->children->len)
+    return 0;
+
+  /* find the last slot starting before the pointer */
+  lower = 0;
+  upper = offsets->len;
+  while (upper - lower > 1)
+    {
+      mid = (lower + upper) / 2;
+      if (g_array_index (offsets, gint, mid) <= x)
+        lower = mid;
+      else
+        upper = mid;
+    }
+
+  /* walk back to the first slot at this offset, which is the
+   * first item of a column of small children */
+  while (lower > 0)
+    {
+      child = g_ptr_array_index (itembar->children, lower);
+      if (g_array_index (offsets, gint, lower - 1) != g_array_index (offsets, gint, lower)
+          && (child == NULL || child->option != CHILD_OPTION_SMALL || child->row == 0))
+        break;
+      lower--;
+    }
+
+  return lower;
+}
+
+
+
 guint
 panel_itembar_get_drop_index (PanelItembar *itembar,
                               gint x,
                               gint y)
 {
   PanelItembarChild *child, *child2;
-  GSList *li, *li2;
   GtkAllocation alloc;
-  guint idx, col_start_idx, col_end_idx;
+  guint i, j, idx, col_start_idx, col_end_idx;
   gint xr, yr, col_width;
   gdouble aspect;
 
@@ -1193,17 +1305,22 @@ panel_itembar_get_drop_index (PanelItembar *itembar,
 
   /* return -1 if point is outside the widget allocation */
   if (x < alloc.x || y < alloc.y || x >= alloc.x + alloc.width || y >= alloc.y + alloc.height)
-    return g_slist_length (itembar->children);
+    return itembar->children->len;
 
   col_width = -1;
   itembar->highlight_length = -1;
-  idx = 0;
   col_start_idx = 0;
   col_end_idx = 0;
 
-  for (li = itembar->children; li != NULL; li = g_slist_next (li))
+  /* skip the items before the pointer, the highlight slot does not count */
+  i = panel_itembar_get_drop_slot (itembar, x);
+  idx = i;
+  if (itembar->highlight_index != -1 && itembar->highlight_slot < i)
+    idx--;
+
+  for (; i < itembar->children->len; i++)
     {
-      child = li->data;
+      child = g_ptr_array_index (itembar->children, i);
       if (G_UNLIKELY (child == NULL))
         continue;
 
@@ -1225,9 +1342,9 @@ panel_itembar_get_drop_index (PanelItembar *itembar,
               col_end_idx = idx + 1;
               col_width = alloc.width;
               /* find the width of the current column and the idx of last item */
-              for (li2 = g_slist_next (li); li2 != NULL; li2 = g_slist_next (li2))
+              for (j = i + 1; j < itembar->children->len; j++)
                 {
-                  child2 = li2->data;
+                  child2 = g_ptr_array_index (itembar->children, j);
                   if (G_UNLIKELY (child2 == NULL))
                     continue;
                   if (child2->row == 0)
@@ -1296,11 +1413,19 @@ panel_itembar_set_drop_highlight_item (PanelItembar *itembar,
     return;
 
   if (itembar->highlight_index != -1)
-    itembar->children = g_slist_remove_all (itembar->children, NULL);
+    {
+      g_ptr_array_remove_index (itembar->children, itembar->highlight_slot);
+      panel_itembar_update_indices (itembar, itembar->highlight_slot);
+    }
+
   if (idx != -1)
-    itembar->children = g_slist_insert (itembar->children, NULL, idx);
+    {
+      itembar->highlight_slot = MIN ((guint) idx, itembar->children->len);
+      g_ptr_array_insert (itembar->children, itembar->highlight_slot, NULL);
+      panel_itembar_update_indices (itembar, itembar->highlight_slot);
+    }
 
   itembar->highlight_index = idx;
 
-  gtk_widget_queue_resize (GTK_WIDGET (itembar));
+  panel_itembar_queue_resize (itembar);
 }
@@ -0,0 +1,383 @@
+/*
+ * Copyright (C) 2026 The Xfce Development Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "panel-layout.h"
+
+#include "common/panel-private.h"
+
+#include <libxfce4util/libxfce4util.h>
+#include <stdio.h>
+#include <string.h>
+
+
+
+#define SNAP_DISTANCE (10)
+
+
+
+typedef struct _PanelLayoutMonitor PanelLayoutMonitor;
+
+
+
+struct _PanelLayoutSnapshot
+{
+  gatomicrefcount ref_count;
+
+  /* monitors in the order of the windowing screen */
+  GArray *monitors;
+};
+
+struct _PanelLayoutMonitor
+{
+  GdkRectangle geometry;
+  gchar *connector;
+  guint primary : 1;
+};
+
+enum
+{
+  EDGE_GRAVITY_NONE = 0,
+  EDGE_GRAVITY_START = (SNAP_POSITION_NE - SNAP_POSITION_E),
+  EDGE_GRAVITY_CENTER = (SNAP_POSITION_EC - SNAP_POSITION_E),
+  EDGE_GRAVITY_END = (SNAP_POSITION_SE - SNAP_POSITION_E)
+};
+
+
+
+static void
+panel_layout_monitor_clear (gpointer data)
+{
+  PanelLayoutMonitor *monitor = data;
+
+  g_free (monitor->connector);
+}
+
+
+
+PanelLayoutSnapshot *
+panel_layout_snapshot_new (void)
+{
+  PanelLayoutSnapshot *snapshot;
+
+  snapshot = g_slice_new0 (PanelLayoutSnapshot);
+  g_atomic_ref_count_init (&snapshot->ref_count);
+  snapshot->monitors = g_array_new (FALSE, FALSE, sizeof (PanelLayoutMonitor));
+  g_array_set_clear_func (snapshot->monitors, panel_layout_monitor_clear);
+
+  return snapshot;
+}
+
+
+
+PanelLayoutSnapshot *
+panel_layout_snapshot_ref (PanelLayoutSnapshot *snapshot)
+{
+  panel_return_val_if_fail (snapshot != NULL, NULL);
+
+  g_atomic_ref_count_inc (&snapshot->ref_count);
+
+  return snapshot;
+}
+
+
+
+void
+panel_layout_snapshot_unref (PanelLayoutSnapshot *snapshot)
+{
+  panel_return_if_fail (snapshot != NULL);
+
+  if (g_atomic_ref_count_dec (&snapshot->ref_count))
+    {
+      g_array_free (snapshot->monitors, TRUE);
+      g_slice_free (PanelLayoutSnapshot, snapshot);
+    }
+}
+
+
+
+void
+panel_layout_snapshot_add_monitor (PanelLayoutSnapshot *snapshot,
+                                   const GdkRectangle *geometry,
+                                   const gchar *connector,
+                                   gboolean primary)
+{
+  PanelLayoutMonitor monitor;
+
+  panel_return_if_fail (snapshot != NULL);
+  panel_return_if_fail (geometry != NULL);
+
+  /* the snapshot is immutable once it is shared */
+  panel_return_if_fail (g_atomic_ref_count_compare (&snapshot->ref_count, 1));
+
+  monitor.geometry = *geometry;
+  monitor.connector = g_strdup (connector);
+  monitor.primary = !!primary;
+  g_array_append_val (snapshot->monitors, monitor);
+}
+
+
+
+guint
+panel_layout_snapshot_get_n_monitors (PanelLayoutSnapshot *snapshot)
+{
+  panel_return_val_if_fail (snapshot != NULL, 0);
+
+  return snapshot->monitors->len;
+}
+
+
+
+static gint
+panel_layout_monitor_at_point (PanelLayoutSnapshot *snapshot,
+                               gint x,
+                               gint y)
+{
+  PanelLayoutMonitor *monitor;
+  gint nearest = 0;
+  gint64 distance, nearest_distance = G_MAXINT64;
+  gint dx, dy;
+  guint i;
+
+  /* like gdk_display_get_monitor_at_point(): the monitor containing the
+   * point or else the nearest one */
+  for (i = 0; i < snapshot->monitors->len; i++)
+    {
+      monitor = &g_array_index (snapshot->monitors, PanelLayoutMonitor, i);
+
+      dx = 0;
+      if (x < monitor->geometry.x)
+        dx = monitor->geometry.x - x;
+      else if (x >= monitor->geometry.x + monitor->geometry.width)
+        dx = x - (monitor->geometry.x + monitor->geometry.width - 1);
+
+      dy = 0;
+      if (y < monitor->geometry.y)
+        dy = monitor->geometry.y - y;
+      else if (y >= monitor->geometry.y + monitor->geometry.height)
+        dy = y - (monitor->geometry.y + monitor->geometry.height - 1);
+
+      if (dx == 0 && dy == 0)
+        return i;
+
+      distance = (gint64) dx * dx + (gint64) dy * dy;
+      if (distance < nearest_distance)
+        {
+          nearest_distance = distance;
+          nearest = i;
+        }
+    }
+
+  return nearest;
+}
+
+
+
+static gint
+panel_layout_monitor_for_output (PanelLayoutSnapshot *snapshot,
+                                 const PanelLayoutPanel *panel)
+{
+  PanelLayoutMonitor *monitor;
+  const gchar *p;
+  gint n;
+  guint i;
+
+  if (g_strcmp0 (panel->output_name, "Automatic") == 0
+      || panel->output_name == NULL)
+    {
+      /* get the monitor geometry based on the panel position */
+      return panel_layout_monitor_at_point (snapshot, panel->base_x, panel->base_y);
+    }
+
+  if (g_strcmp0 (panel->output_name, "Primary") == 0)
+    {
+      /* get the primary monitor, or the first one */
+      for (i = 0; i < snapshot->monitors->len; i++)
+        if (g_array_index (snapshot->monitors, PanelLayoutMonitor, i).primary)
+          return i;
+
+      return 0;
+    }
+
+  /* check if we've stored the monitor number in the config or
+   * should lookup the number from the randr output name */
+  if (strncmp (panel->output_name, "monitor-", 8) == 0
+      && sscanf (panel->output_name, "monitor-%d", &n) == 1)
+    {
+      /* check if extracted monitor number is out of range */
+      if (n < 0 || (guint) n >= snapshot->monitors->len)
+        return -1;
+
+      monitor = &g_array_index (snapshot->monitors, PanelLayoutMonitor, n);
+      if (xfce_str_is_empty (monitor->connector))
+        return n;
+
+      p = strchr (panel->output_name + 8, '-');
+      if (p != NULL && g_strcmp0 (p + 1, monitor->connector) == 0)
+        return n;
+
+      return -1;
+    }
+
+  /* detect the monitor number by output name */
+  for (i = 0; i < snapshot->monitors->len; i++)
+    if (g_strcmp0 (panel->output_name,
+                   g_array_index (snapshot->monitors, PanelLayoutMonitor, i).connector)
+        == 0)
+      return i;
+
+  return -1;
+}
+
+
+
+static void
+panel_layout_solve_panel (PanelLayoutSnapshot *snapshot,
+                          const PanelLayoutPanel *panel,
+                          const GdkRectangle *screen_area,
+                          PanelLayoutResult *result)
+{
+  gint n;
+
+  result->monitor = -1;
+  result->area.x = result->area.y = 0;
+  result->area.width = result->area.height = 0;
+
+  if (snapshot->monitors->len == 0)
+    return;
+
+  if ((panel->output_name == NULL || g_strcmp0 (panel->output_name, "Automatic") == 0)
+      && (panel->span_monitors || snapshot->monitors->len == 1))
+    {
+      /* use the screen geometry, also if there is only one monitor and
+       * no output is choosen, as a fast-path */
+      result->monitor = 0;
+      result->area = *screen_area;
+      return;
+    }
+
+  n = panel_layout_monitor_for_output (snapshot, panel);
+  if (n == -1)
+    return;
+
+  result->monitor = n;
+  result->area = g_array_index (snapshot->monitors, PanelLayoutMonitor, n).geometry;
+}
+
+
+
+void
+panel_layout_solve (PanelLayoutSnapshot *snapshot,
+                    const PanelLayoutPanel *panels,
+                    PanelLayoutResult *results,
+                    guint n_panels)
+{
+  GdkRectangle screen_area = { 0 };
+  GdkRectangle *geometry;
+  guint i;
+
+  panel_return_if_fail (snapshot != NULL);
+  panel_return_if_fail (n_panels == 0 || (panels != NULL && results != NULL));
+
+  /* the bounding box of all monitors is shared by all spanning panels */
+  for (i = 0; i < snapshot->monitors->len; i++)
+    {
+      geometry = &g_array_index (snapshot->monitors, PanelLayoutMonitor, i).geometry;
+      if (i == 0)
+        screen_area = *geometry;
+      else
+        gdk_rectangle_union (&screen_area, geometry, &screen_area);
+    }
+
+  for (i = 0; i < n_panels; i++)
+    panel_layout_solve_panel (snapshot, &panels[i], &screen_area, &results[i]);
+}
+
+
+
+static inline guint
+panel_layout_snap_edge_gravity (gint value,
+                                gint start,
+                                gint end)
+{
+  gint center;
+
+  /* snap at the start */
+  if (value >= start && value <= start + SNAP_DISTANCE)
+    return EDGE_GRAVITY_START;
+
+  /* snap at the end */
+  if (value <= end && value >= end - SNAP_DISTANCE)
+    return EDGE_GRAVITY_END;
+
+  /* snap at the center */
+  center = start + (end - start) / 2;
+  if (value >= center - 10 && value <= center + SNAP_DISTANCE)
+    return EDGE_GRAVITY_CENTER;
+
+  return EDGE_GRAVITY_NONE;
+}
+
+
+
+SnapPosition
+panel_layout_snap_position (const GdkRectangle *alloc,
+                            const GdkRectangle *area,
+                            PanelBorders borders)
+{
+  guint snap_horz, snap_vert;
+  GdkRectangle a = *alloc;
+
+  /* make the same calculation whether the panel is snapped or not (avoids flickering
+   * when the pointer moves slowly) */
+  if (!PANEL_HAS_FLAG (borders, PANEL_BORDER_TOP) && PANEL_HAS_FLAG (borders, PANEL_BORDER_BOTTOM))
+    a.height++;
+  else if (PANEL_HAS_FLAG (borders, PANEL_BORDER_TOP) && !PANEL_HAS_FLAG (borders, PANEL_BORDER_BOTTOM))
+    {
+      a.y--;
+      a.height++;
+    }
+  if (!PANEL_HAS_FLAG (borders, PANEL_BORDER_LEFT) && PANEL_HAS_FLAG (borders, PANEL_BORDER_RIGHT))
+    a.width++;
+  else if (PANEL_HAS_FLAG (borders, PANEL_BORDER_LEFT) && !PANEL_HAS_FLAG (borders, PANEL_BORDER_RIGHT))
+    {
+      a.x--;
+      a.width++;
+    }
+
+  /* get the snap offsets */
+  snap_horz = panel_layout_snap_edge_gravity (a.x, area->x,
+                                              area->x + area->width - a.width);
+  snap_vert = panel_layout_snap_edge_gravity (a.y, area->y,
+                                              area->y + area->height - a.height);
+
+  /* detect the snap mode */
+  if (snap_horz == EDGE_GRAVITY_START)
+    return SNAP_POSITION_W + snap_vert;
+  else if (snap_horz == EDGE_GRAVITY_END)
+    return SNAP_POSITION_E + snap_vert;
+  else if (snap_horz == EDGE_GRAVITY_CENTER && snap_vert == EDGE_GRAVITY_START)
+    return SNAP_POSITION_NC;
+  else if (snap_horz == EDGE_GRAVITY_CENTER && snap_vert == EDGE_GRAVITY_END)
+    return SNAP_POSITION_SC;
+  else if (snap_horz == EDGE_GRAVITY_NONE && snap_vert == EDGE_GRAVITY_START)
+    return SNAP_POSITION_N;
+  else if (snap_horz == EDGE_GRAVITY_NONE && snap_vert == EDGE_GRAVITY_END)
+    return SNAP_POSITION_S;
+
+  return SNAP_POSITION_NONE;
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2026 The Xfce Development Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __PANEL_LAYOUT_H__
+#define __PANEL_LAYOUT_H__
+
+#include "panel-base-window.h"
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+/* the layout solver works on an immutable snapshot of the monitors and
+ * does not touch any GTK or windowing state, so it can be called from
+ * any thread */
+typedef struct _PanelLayoutSnapshot PanelLayoutSnapshot;
+typedef struct _PanelLayoutPanel PanelLayoutPanel;
+typedef struct _PanelLayoutResult PanelLayoutResult;
+
+typedef enum _SnapPosition
+{
+  /* no snapping */
+  SNAP_POSITION_NONE, /* snapping */
+
+  /* right edge */
+  SNAP_POSITION_E, /* right */
+  SNAP_POSITION_NE, /* top right */
+  SNAP_POSITION_EC, /* right center */
+  SNAP_POSITION_SE, /* bottom right */
+
+  /* left edge */
+  SNAP_POSITION_W, /* left */
+  SNAP_POSITION_NW, /* top left */
+  SNAP_POSITION_WC, /* left center */
+  SNAP_POSITION_SW, /* bottom left */
+
+  /* top and bottom */
+  SNAP_POSITION_NC, /* top center */
+  SNAP_POSITION_SC, /* bottom center */
+  SNAP_POSITION_N, /* top */
+  SNAP_POSITION_S, /* bottom */
+} SnapPosition;
+
+struct _PanelLayoutPanel
+{
+  /* output-name and span-monitors of the panel, the string is
+   * owned by the caller */
+  const gchar *output_name;
+  gboolean span_monitors;
+
+  /* center of the panel on the screen */
+  gint base_x;
+  gint base_y;
+};
+
+struct _PanelLayoutResult
+{
+  /* index of the monitor in the snapshot or -1 if the
+   * panel has no usable monitor */
+  gint monitor;
+
+  /* working area of the panel */
+  GdkRectangle area;
+};
+
+PanelLayoutSnapshot *
+panel_layout_snapshot_new (void) G_GNUC_MALLOC;
+
+PanelLayoutSnapshot *
+panel_layout_snapshot_ref (PanelLayoutSnapshot *snapshot);
+
+void
+panel_layout_snapshot_unref (PanelLayoutSnapshot *snapshot);
+
+void
+panel_layout_snapshot_add_monitor (PanelLayoutSnapshot *snapshot,
+                                   const GdkRectangle *geometry,
+                                   const gchar *connector,
+                                   gboolean primary);
+
+guint
+panel_layout_snapshot_get_n_monitors (PanelLayoutSnapshot *snapshot);
+
+void
+panel_layout_solve (PanelLayoutSnapshot *snapshot,
+                    const PanelLayoutPanel *panels,
+                    PanelLayoutResult *results,
+                    guint n_panels);
+
+SnapPosition
+panel_layout_snap_position (const GdkRectangle *alloc,
+                            const GdkRectangle *area,
+                            PanelBorders borders);
+
+G_END_DECLS
+
+#endif /* !__PANEL_LAYOUT_H__ */
@@ -0,0 +1,322 @@
+/*
+ * Copyright (C) 2026 The Xfce Development Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * The module cache stores the parsed plugin desktop files of each plugin
+ * directory in a GVariant file in the user's cache directory. On startup
+ * the file is memory-mapped and the records of a directory are used as
+ * long as the modification time of the data and library directory did not
+ * change, so the desktop files are only read again after a plugin has been
+ * (un)installed.
+ */
+
+#include "panel-module-cache.h"
+#include "panel-module.h"
+
+#include "common/panel-debug.h"
+#include "common/panel-private.h"
+
+#include <glib/gstdio.h>
+#include <libxfce4util/libxfce4util.h>
+#include <locale.h>
+
+
+
+/* bump this when the record format changes, the value also acts as
+ * byte order mark, since the file is stored in host byte order */
+#define CACHE_VERSION (1)
+#define CACHE_FILENAME PANEL_PLUGIN_RELATIVE_PATH G_DIR_SEPARATOR_S "modules.cache"
+#define CACHE_DIR_TYPE "(ssxxa" PANEL_MODULE_CACHE_RECORD_TYPE ")"
+#define CACHE_TYPE "(usa" CACHE_DIR_TYPE ")"
+
+
+
+typedef struct
+{
+  gint64 datadir_mtime;
+  gint64 libdir_mtime;
+} PanelModuleCacheStamp;
+
+struct _PanelModuleCache
+{
+  /* key -> directory entry of the mapped cache file or a scan */
+  GHashTable *dirs;
+
+  /* key -> PanelModuleCacheStamp of the directories on disk */
+  GHashTable *stamps;
+
+  /* translated names are stored, so the cache depends on the locale */
+  gchar *locale;
+
+  /* whether entries changed compared to the cache file */
+  guint dirty : 1;
+};
+
+
+
+static gchar *
+panel_module_cache_key (const gchar *datadir,
+                        const gchar *libdir)
+{
+  return g_strconcat (datadir, G_SEARCHPATH_SEPARATOR_S, libdir, NULL);
+}
+
+
+
+static gint64
+panel_module_cache_get_mtime (const gchar *path)
+{
+  GStatBuf statbuf;
+
+  if (g_stat (path, &statbuf) != 0)
+    return 0;
+
+  return statbuf.st_mtime;
+}
+
+
+
+static PanelModuleCacheStamp *
+panel_module_cache_get_stamp (PanelModuleCache *cache,
+                              const gchar *datadir,
+                              const gchar *libdir)
+{
+  PanelModuleCacheStamp *stamp;
+  gchar *key;
+
+  key = panel_module_cache_key (datadir, libdir);
+  stamp = g_hash_table_lookup (cache->stamps, key);
+  if (stamp == NULL)
+    {
+      /* stat the directories only once, before they are scanned */
+      stamp = g_new (PanelModuleCacheStamp, 1);
+      stamp->datadir_mtime = panel_module_cache_get_mtime (datadir);
+      stamp->libdir_mtime = panel_module_cache_get_mtime (libdir);
+      g_hash_table_insert (cache->stamps, key, stamp);
+    }
+  else
+    g_free (key);
+
+  return stamp;
+}
+
+
+
+static void
+panel_module_cache_load (PanelModuleCache *cache)
+{
+  GMappedFile *mapped;
+  GError *error = NULL;
+  GBytes *bytes;
+  GVariant *root, *dirs, *entry;
+  GVariantIter iter;
+  const gchar *locale, *datadir, *libdir;
+  gchar *filename;
+  guint32 version;
+
+  filename = xfce_resource_lookup (XFCE_RESOURCE_CACHE, CACHE_FILENAME);
+  if (filename == NULL)
+    return;
+
+  mapped = g_mapped_file_new (filename, FALSE, &error);
+  if (G_UNLIKELY (mapped == NULL))
+    {
+      panel_debug (PANEL_DEBUG_MODULE_FACTORY, "failed to map %s: %s",
+                   filename, error->message);
+      g_error_free (error);
+      g_free (filename);
+      return;
+    }
+
+  /* the variant keeps a reference on the mapped file */
+  bytes = g_mapped_file_get_bytes (mapped);
+  root = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE (CACHE_TYPE), bytes, FALSE));
+  g_mapped_file_unref (mapped);
+  g_bytes_unref (bytes);
+
+  g_variant_get (root, "(u&s@a" CACHE_DIR_TYPE ")", &version, &locale, &dirs);
+  if (version == CACHE_VERSION && g_strcmp0 (locale, cache->locale) == 0)
+    {
+      g_variant_iter_init (&iter, dirs);
+      while ((entry = g_variant_iter_next_value (&iter)) != NULL)
+        {
+          g_variant_get_child (entry, 0, "&s", &datadir);
+          g_variant_get_child (entry, 1, "&s", &libdir);
+          g_hash_table_insert (cache->dirs, panel_module_cache_key (datadir, libdir), entry);
+        }
+
+      panel_debug (PANEL_DEBUG_MODULE_FACTORY, "loaded %u directories from %s",
+                   g_hash_table_size (cache->dirs), filename);
+    }
+  else
+    {
+      panel_debug (PANEL_DEBUG_MODULE_FACTORY, "ignoring outdated cache %s", filename);
+    }
+
+  g_variant_unref (dirs);
+  g_variant_unref (root);
+  g_free (filename);
+}
+
+
+
+PanelModuleCache *
+panel_module_cache_new (void)
+{
+  PanelModuleCache *cache;
+  const gchar *locale;
+
+  cache = g_slice_new0 (PanelModuleCache);
+  cache->dirs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_variant_unref);
+  cache->stamps = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+  locale = setlocale (LC_MESSAGES, NULL);
+  cache->locale = g_strdup (locale != NULL ? locale : "C");
+
+  panel_module_cache_load (cache);
+
+  return cache;
+}
+
+
+
+void
+panel_module_cache_free (PanelModuleCache *cache)
+{
+  panel_return_if_fail (cache != NULL);
+
+  g_hash_table_destroy (cache->dirs);
+  g_hash_table_destroy (cache->stamps);
+  g_free (cache->locale);
+  g_slice_free (PanelModuleCache, cache);
+}
+
+
+
+GVariant *
+panel_module_cache_lookup (PanelModuleCache *cache,
+                           const gchar *datadir,
+                           const gchar *libdir)
+{
+  PanelModuleCacheStamp *stamp;
+  GVariant *entry;
+  gint64 datadir_mtime, libdir_mtime;
+  gchar *key;
+
+  panel_return_val_if_fail (cache != NULL, NULL);
+  panel_return_val_if_fail (datadir != NULL && libdir != NULL, NULL);
+
+  stamp = panel_module_cache_get_stamp (cache, datadir, libdir);
+  if (stamp->datadir_mtime == 0)
+    return NULL;
+
+  key = panel_module_cache_key (datadir, libdir);
+  entry = g_hash_table_lookup (cache->dirs, key);
+  g_free (key);
+
+  if (entry == NULL)
+    return NULL;
+
+  g_variant_get_child (entry, 2, "x", &datadir_mtime);
+  g_variant_get_child (entry, 3, "x", &libdir_mtime);
+  if (datadir_mtime != stamp->datadir_mtime
+      || libdir_mtime != stamp->libdir_mtime)
+    {
+      panel_debug (PANEL_DEBUG_MODULE_FACTORY, "cache of %s is outdated", datadir);
+      return NULL;
+    }
+
+  /* if no records are returned, the directory has to be scanned
+   * and stored with panel_module_cache_update() */
+  return g_variant_get_child_value (entry, 4);
+}
+
+
+
+void
+panel_module_cache_update (PanelModuleCache *cache,
+                           const gchar *datadir,
+                           const gchar *libdir,
+                           GVariant *records)
+{
+  PanelModuleCacheStamp *stamp;
+  GVariant *entry;
+
+  panel_return_if_fail (cache != NULL);
+  panel_return_if_fail (datadir != NULL && libdir != NULL);
+  panel_return_if_fail (g_variant_is_of_type (records, G_VARIANT_TYPE ("a" PANEL_MODULE_CACHE_RECORD_TYPE)));
+
+  /* use the modification times from before the directory was scanned */
+  stamp = panel_module_cache_get_stamp (cache, datadir, libdir);
+  entry = g_variant_new ("(ssxx@a" PANEL_MODULE_CACHE_RECORD_TYPE ")",
+                         datadir, libdir,
+                         stamp->datadir_mtime, stamp->libdir_mtime,
+                         records);
+
+  /* following lookups of the directory will return the new records */
+  g_hash_table_insert (cache->dirs, panel_module_cache_key (datadir, libdir), g_variant_ref_sink (entry));
+  cache->dirty = TRUE;
+}
+
+
+
+void
+panel_module_cache_save (PanelModuleCache *cache)
+{
+  GVariantBuilder builder;
+  GVariant *root;
+  GHashTableIter iter;
+  gpointer entry;
+  GError *error = NULL;
+  gchar *filename;
+
+  panel_return_if_fail (cache != NULL);
+
+  if (!cache->dirty)
+    return;
+
+  filename = xfce_resource_save_location (XFCE_RESOURCE_CACHE, CACHE_FILENAME, TRUE);
+  if (G_UNLIKELY (filename == NULL))
+    return;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a" CACHE_DIR_TYPE));
+  g_hash_table_iter_init (&iter, cache->dirs);
+  while (g_hash_table_iter_next (&iter, NULL, &entry))
+    g_variant_builder_add_value (&builder, entry);
+
+  root = g_variant_ref_sink (g_variant_new ("(us@a" CACHE_DIR_TYPE ")",
+                                            (guint32) CACHE_VERSION, cache->locale,
+                                            g_variant_builder_end (&builder)));
+
+  /* written atomically, so a running panel can still use its mapping */
+  if (g_file_set_contents (filename, g_variant_get_data (root), g_variant_get_size (root), &error))
+    {
+      panel_debug (PANEL_DEBUG_MODULE_FACTORY, "saved %u directories to %s",
+                   g_hash_table_size (cache->dirs), filename);
+      cache->dirty = FALSE;
+    }
+  else
+    {
+      panel_debug (PANEL_DEBUG_MODULE_FACTORY, "failed to save %s: %s",
+                   filename, error->message);
+      g_error_free (error);
+    }
+
+  g_variant_unref (root);
+  g_free (filename);
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2026 The Xfce Development Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __PANEL_MODULE_CACHE_H__
+#define __PANEL_MODULE_CACHE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _PanelModuleCache PanelModuleCache;
+
+PanelModuleCache *
+panel_module_cache_new (void) G_GNUC_MALLOC;
+
+void
+panel_module_cache_free (PanelModuleCache *cache);
+
+GVariant *
+panel_module_cache_lookup (PanelModuleCache *cache,
+                           const gchar *datadir,
+                           const gchar *libdir);
+
+void
+panel_module_cache_update (PanelModuleCache *cache,
+                           const gchar *datadir,
+                           const gchar *libdir,
+                           GVariant *records);
+
+void
+panel_module_cache_save (PanelModuleCache *cache);
+
+G_END_DECLS
+
+#endif /* !__PANEL_MODULE_CACHE_H__ */
@@ -16,6 +16,7 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include "panel-module-cache.h"
 #include "panel-module-factory.h"
 
 #include "common/panel-debug.h"
@@ -29,6 +30,8 @@
 static void
 panel_module_factory_finalize (GObject *object);
 static void
+panel_module_factory_find_dirs (PanelModuleFactory *factory);
+static void
 panel_module_factory_load_modules (PanelModuleFactory *factory);
 static gboolean
 panel_module_factory_modules_cleanup (gpointer key,
@@ -53,11 +56,20 @@ struct _PanelModuleFactory
   /* relation for name -> PanelModule */
   GHashTable *modules;
 
+  /* plugin data and library directories, in order of priority */
+  GList *datadirs;
+  GList *libdirs;
+
+  /* parsed desktop files of the plugin directories */
+  PanelModuleCache *cache;
+  guint save_cache_id;
+
   /* all plugins in all windows */
   GSList *plugins;
 
-  /* if the factory contains the launcher plugin */
-  guint has_launcher : 1;
+  /* if all the modules on disk are in the hash table, otherwise
+   * modules are only loaded when they are looked up by name */
+  guint modules_loaded : 1;
 };
 
 
@@ -95,12 +107,13 @@ panel_module_factory_class_init (PanelModuleFactoryClass *klass)
 static void
 panel_module_factory_init (PanelModuleFactory *factory)
 {
-  factory->has_launcher = FALSE;
+  factory->modules_loaded = FALSE;
   factory->modules = g_hash_table_new_full (g_str_hash, g_str_equal,
                                             g_free, g_object_unref);
 
-  /* load all the modules */
-  panel_module_factory_load_modules (factory);
+  /* modules are loaded on demand, so only the plugins used in the
+   * panels are loaded on startup */
+  panel_module_factory_find_dirs (factory);
 }
 
 
@@ -110,8 +123,19 @@ panel_module_factory_finalize (GObject *object)
 {
   PanelModuleFactory *factory = PANEL_MODULE_FACTORY (object);
 
+  if (factory->save_cache_id != 0)
+    g_source_remove (factory->save_cache_id);
+
+  if (factory->cache != NULL)
+    {
+      panel_module_cache_save (factory->cache);
+      panel_module_cache_free (factory->cache);
+    }
+
   g_hash_table_destroy (factory->modules);
   g_slist_free (factory->plugins);
+  g_list_free_full (factory->datadirs, g_free);
+  g_list_free_full (factory->libdirs, g_free);
 
   (*G_OBJECT_CLASS (panel_module_factory_parent_class)->finalize) (object);
 }
@@ -119,23 +143,74 @@ panel_module_factory_finalize (GObject *object)
 
 
 static void
-panel_module_factory_load_modules_dir (PanelModuleFactory *factory,
-                                       const gchar *datadir,
-                                       const gchar *libdir)
+panel_module_factory_add_module (PanelModuleFactory *factory,
+                                 PanelModule *module)
+{
+  /* add the module to the internal list */
+  g_hash_table_insert (factory->modules, g_strdup (panel_module_get_name (module)), module);
+}
+
+
+
+static gboolean
+panel_module_factory_save_cache (gpointer user_data)
+{
+  PanelModuleFactory *factory = PANEL_MODULE_FACTORY (user_data);
+
+  factory->save_cache_id = 0;
+
+  if (factory->cache != NULL)
+    panel_module_cache_save (factory->cache);
+
+  return FALSE;
+}
+
+
+
+static PanelModuleCache *
+panel_module_factory_get_cache (PanelModuleFactory *factory)
 {
+  if (factory->cache == NULL)
+    factory->cache = panel_module_cache_new ();
+
+  /* write all directories scanned in this iteration at once */
+  if (factory->save_cache_id == 0)
+    factory->save_cache_id = g_idle_add (panel_module_factory_save_cache, factory);
+
+  return factory->cache;
+}
+
+
+
+static GVariant *
+panel_module_factory_get_records (PanelModuleFactory *factory,
+                                  const gchar *datadir,
+                                  const gchar *libdir)
+{
+  PanelModuleCache *cache;
   GDir *dir;
   const gchar *name, *p;
   gchar *filename;
   PanelModule *module;
   gchar *internal_name;
+  GVariant *records;
+  GVariantBuilder builder;
+
+  /* use the cached desktop files if the directory did not change */
+  cache = panel_module_factory_get_cache (factory);
+  records = panel_module_cache_lookup (cache, datadir, libdir);
+  if (records != NULL)
+    return records;
 
   /* try to open the directory */
   dir = g_dir_open (datadir, 0, NULL);
   if (G_UNLIKELY (dir == NULL))
-    return;
+    return NULL;
 
   panel_debug (PANEL_DEBUG_MODULE_FACTORY, "reading %s", datadir);
 
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a" PANEL_MODULE_CACHE_RECORD_TYPE));
+
   /* walk the directory */
   for (;;)
     {
@@ -158,11 +233,8 @@ panel_module_factory_load_modules_dir (PanelModuleFactory *factory,
       /* get the new module internal name */
       internal_name = g_strndup (name, p - name);
 
-      /* check if the modules name is already loaded */
-      if (g_hash_table_lookup (factory->modules, internal_name) != NULL)
-        goto exists;
-
-      /* try to load the module */
+      /* try to read the module, also if the name is already loaded
+       * from another directory, so the records of this directory are complete */
       module = panel_module_new_from_desktop_file (filename,
                                                    internal_name,
                                                    libdir,
@@ -170,29 +242,120 @@ panel_module_factory_load_modules_dir (PanelModuleFactory *factory,
 
       if (G_LIKELY (module != NULL))
         {
-          /* add the module to the internal list */
-          g_hash_table_insert (factory->modules, internal_name, module);
-
-          /* check if this is the launcher */
-          if (!factory->has_launcher)
-            factory->has_launcher = g_strcmp0 (LAUNCHER_PLUGIN_NAME, internal_name) == 0;
-        }
-      else
-        {
-exists:
-          g_free (internal_name);
+          g_variant_builder_add_value (&builder, panel_module_get_cache_record (module));
+          g_object_unref (G_OBJECT (module));
         }
 
+      g_free (internal_name);
       g_free (filename);
     }
 
   g_dir_close (dir);
+
+  records = g_variant_ref_sink (g_variant_builder_end (&builder));
+  panel_module_cache_update (cache, datadir, libdir, records);
+
+  return records;
+}
+
+
+
+static PanelModule *
+panel_module_factory_lookup_module (PanelModuleFactory *factory,
+                                    const gchar *name)
+{
+  PanelModule *module;
+  GVariant *records, *record;
+  GVariantIter iter;
+  const gchar *record_name;
+
+  module = g_hash_table_lookup (factory->modules, name);
+  if (module != NULL || factory->modules_loaded)
+    return module;
+
+  /* find the first directory that provides this module, without
+   * loading the other modules in the directories */
+  for (GList *lp = factory->datadirs, *lq = factory->libdirs;
+       module == NULL && lp != NULL && lq != NULL;
+       lp = lp->next, lq = lq->next)
+    {
+      records = panel_module_factory_get_records (factory, lp->data, lq->data);
+      if (records == NULL)
+        continue;
+
+      g_variant_iter_init (&iter, records);
+      while (module == NULL && (record = g_variant_iter_next_value (&iter)) != NULL)
+        {
+          g_variant_get_child (record, 0, "&s", &record_name);
+          if (strcmp (record_name, name) == 0)
+            module = panel_module_new_from_cache_record (record, force_all_run_mode);
+
+          g_variant_unref (record);
+        }
+
+      g_variant_unref (records);
+    }
+
+  if (G_LIKELY (module != NULL))
+    {
+      panel_debug (PANEL_DEBUG_MODULE_FACTORY, "loaded module %s on demand", name);
+      panel_module_factory_add_module (factory, module);
+    }
+
+  return module;
 }
 
 
 
 static void
 panel_module_factory_load_modules (PanelModuleFactory *factory)
+{
+  GVariant *records, *record;
+  GVariantIter iter;
+  const gchar *name;
+  PanelModule *module;
+
+  panel_return_if_fail (PANEL_IS_MODULE_FACTORY (factory));
+
+  /* start with a new cache, so changed directories are detected */
+  if (factory->cache != NULL)
+    {
+      panel_module_cache_save (factory->cache);
+      panel_module_cache_free (factory->cache);
+      factory->cache = NULL;
+    }
+
+  for (GList *lp = factory->datadirs, *lq = factory->libdirs; lp != NULL && lq != NULL; lp = lp->next, lq = lq->next)
+    {
+      records = panel_module_factory_get_records (factory, lp->data, lq->data);
+      if (records == NULL)
+        continue;
+
+      g_variant_iter_init (&iter, records);
+      while ((record = g_variant_iter_next_value (&iter)) != NULL)
+        {
+          /* check if the modules name is already loaded */
+          g_variant_get_child (record, 0, "&s", &name);
+          if (g_hash_table_lookup (factory->modules, name) == NULL)
+            {
+              module = panel_module_new_from_cache_record (record, force_all_run_mode);
+              if (G_LIKELY (module != NULL))
+                panel_module_factory_add_module (factory, module);
+            }
+
+          g_variant_unref (record);
+        }
+
+      g_variant_unref (records);
+    }
+
+  factory->modules_loaded = TRUE;
+}
+
+
+
+static void
+panel_module_factory_find_dirs (PanelModuleFactory *factory)
 {
   const gchar *plugin_dir_suffix = G_DIR_SEPARATOR_S "xfce4" G_DIR_SEPARATOR_S "panel" G_DIR_SEPARATOR_S "plugins";
   GList *datadirs = NULL, *libdirs = NULL;
@@ -266,11 +429,8 @@ panel_module_factory_load_modules (PanelModuleFactory *factory)
       libdirs = g_list_prepend (libdirs, libdir);
     }
 
-  for (GList *lp = datadirs, *lq = libdirs; lp != NULL && lq != NULL; lp = lp->next, lq = lq->next)
-    panel_module_factory_load_modules_dir (factory, lp->data, lq->data);
-
-  g_list_free_full (datadirs, g_free);
-  g_list_free_full (libdirs, g_free);
+  factory->datadirs = datadirs;
+  factory->libdirs = libdirs;
 }
 
 
@@ -290,11 +450,6 @@ panel_module_factory_modules_cleanup (gpointer key,
   /* check if the executable/library still exists */
   remove_from_table = !panel_module_is_valid (module);
 
-  /* if we're going to remove this item, check if it is the launcher */
-  if (remove_from_table
-      && g_strcmp0 (LAUNCHER_PLUGIN_NAME, panel_module_get_name (module)) == 0)
-    factory->has_launcher = FALSE;
-
   return remove_from_table;
 }
 
@@ -366,7 +521,7 @@ panel_module_factory_has_launcher (PanelModuleFactory *factory)
 {
   panel_return_val_if_fail (PANEL_IS_MODULE_FACTORY (factory), FALSE);
 
-  return factory->has_launcher;
+  return panel_module_factory_lookup_module (factory, LAUNCHER_PLUGIN_NAME) != NULL;
 }
 
 
@@ -408,7 +563,25 @@ panel_module_factory_has_module (PanelModuleFactory *factory,
   panel_return_val_if_fail (PANEL_IS_MODULE_FACTORY (factory), FALSE);
   panel_return_val_if_fail (name != NULL, FALSE);
 
-  return !!(g_hash_table_lookup (factory->modules, name) != NULL);
+  return panel_module_factory_lookup_module (factory, name) != NULL;
+}
+
+
+
+PanelModuleRunMode
+panel_module_factory_get_run_mode (PanelModuleFactory *factory,
+                                   const gchar *name)
+{
+  PanelModule *module;
+
+  panel_return_val_if_fail (PANEL_IS_MODULE_FACTORY (factory), PANEL_MODULE_RUN_MODE_NONE);
+  panel_return_val_if_fail (name != NULL, PANEL_MODULE_RUN_MODE_NONE);
+
+  module = panel_module_factory_lookup_module (factory, name);
+  if (G_UNLIKELY (module == NULL))
+    return PANEL_MODULE_RUN_MODE_NONE;
+
+  return panel_module_get_run_mode (module);
 }
 
 
@@ -465,8 +638,8 @@ panel_module_factory_new_plugin (PanelModuleFactory *factory,
   panel_return_val_if_fail (GDK_IS_SCREEN (screen), NULL);
   panel_return_val_if_fail (name != NULL, NULL);
 
-  /* find the module in the hash table */
-  module = g_hash_table_lookup (factory->modules, name);
+  /* find the module in the hash table or on disk */
+  module = panel_module_factory_lookup_module (factory, name);
   if (G_UNLIKELY (module == NULL))
     {
       panel_debug (PANEL_DEBUG_MODULE_FACTORY, "Module \"%s\" not found in the factory", name);
@@ -53,6 +53,10 @@ gboolean
 panel_module_factory_has_module (PanelModuleFactory *factory,
                                  const gchar *name);
 
+PanelModuleRunMode
+panel_module_factory_get_run_mode (PanelModuleFactory *factory,
+                                   const gchar *name);
+
 GSList *
 panel_module_factory_get_plugins (PanelModuleFactory *factory,
                                   const gchar *plugin_name);
@@ -19,6 +19,7 @@
 #include "panel-module-factory.h"
 #include "panel-module.h"
 #include "panel-plugin-external-wrapper.h"
+#include "panel-trace.h"
 
 #include "common/panel-debug.h"
 #include "common/panel-private.h"
@@ -88,6 +89,11 @@ struct _PanelModule
 
   /* for wrapper plugins */
   gchar *api;
+
+  /* unprocessed desktop file entries, for the module cache */
+  gchar *desktop_api;
+  gchar *desktop_unique;
+  guint desktop_internal : 1;
 };
 
 
@@ -132,6 +138,9 @@ panel_module_init (PanelModule *module)
   module->construct_func = NULL;
   module->plugin_type = G_TYPE_NONE;
   module->api = g_strdup (LIBXFCE4PANEL_VERSION_API);
+  module->desktop_api = NULL;
+  module->desktop_unique = NULL;
+  module->desktop_internal = FALSE;
 }
 
 
@@ -147,6 +156,8 @@ panel_module_dispose (GObject *object)
       g_free (module->display_name);
       g_free (module->comment);
       g_free (module->icon_name);
+      g_free (module->desktop_api);
+      g_free (module->desktop_unique);
       g_clear_pointer (&module->api, g_free);
       if (module->plugin_type != G_TYPE_NONE)
         {
@@ -168,6 +179,7 @@ panel_module_load (GTypeModule *type_module)
   PluginInitFunc init_func;
   gboolean make_resident = TRUE;
   gpointer foo;
+  gint64 trace_begin;
 
   panel_return_val_if_fail (PANEL_IS_MODULE (module), FALSE);
   panel_return_val_if_fail (G_IS_TYPE_MODULE (module), FALSE);
@@ -176,6 +188,8 @@ panel_module_load (GTypeModule *type_module)
   panel_return_val_if_fail (module->plugin_type == G_TYPE_NONE, FALSE);
   panel_return_val_if_fail (module->construct_func == NULL, FALSE);
 
+  trace_begin = panel_trace_begin ();
+
   /* open the module */
   module->library = g_module_open (module->filename, G_MODULE_BIND_LOCAL);
   if (G_UNLIKELY (module->library == NULL))
@@ -236,6 +250,8 @@ panel_module_load (GTypeModule *type_module)
         }
     }
 
+  panel_trace_end (trace_begin, "module", "load", panel_module_get_name (module), -1);
+
   return TRUE;
 }
 
@@ -287,6 +303,68 @@ panel_module_plugin_destroyed (gpointer user_data,
 
 
 
+static PanelModule *
+panel_module_new_internal (const gchar *name,
+                           gchar *filename,
+                           const gchar *display_name,
+                           const gchar *comment,
+                           const gchar *icon_name,
+                           const gchar *api,
+                           gboolean internal,
+                           const gchar *unique,
+                           PanelModuleRunMode forced_mode)
+{
+  PanelModule *module;
+
+  /* create new module, this takes ownership of the filename */
+  module = g_object_new (PANEL_TYPE_MODULE, NULL);
+  module->filename = filename;
+  g_type_module_set_name (G_TYPE_MODULE (module), name);
+
+  /* keep the raw entries around for the module cache */
+  module->desktop_api = g_strdup (api);
+  module->desktop_unique = g_strdup (unique);
+  module->desktop_internal = !!internal;
+
+  /* run mode of the module, by default everything runs in
+   * the wrapper, unless defined otherwise or unsupported */
+  if (forced_mode != PANEL_MODULE_RUN_MODE_INTERNAL
+      && ((WINDOWING_IS_X11 ()
+           && (forced_mode == PANEL_MODULE_RUN_MODE_EXTERNAL || !internal))
+          || (gtk_layer_is_supported () && forced_mode == PANEL_MODULE_RUN_MODE_EXTERNAL)))
+    {
+      module->mode = PANEL_MODULE_RUN_MODE_EXTERNAL;
+      g_free (module->api);
+      module->api = g_strdup (api != NULL ? api : LIBXFCE4PANEL_VERSION_API);
+    }
+  else
+    module->mode = PANEL_MODULE_RUN_MODE_INTERNAL;
+
+  panel_assert (module->mode != PANEL_MODULE_RUN_MODE_NONE);
+
+  /* set the remaining information */
+  module->display_name = g_strdup (display_name != NULL ? display_name : name);
+  module->comment = g_strdup (comment);
+  module->icon_name = g_strdup (icon_name);
+
+  if (G_LIKELY (unique == NULL))
+    module->unique_mode = UNIQUE_FALSE;
+  else if (strcasecmp (unique, "screen") == 0 && WINDOWING_IS_X11 ())
+    module->unique_mode = UNIQUE_SCREEN;
+  else if (strcasecmp (unique, "true") == 0)
+    module->unique_mode = UNIQUE_TRUE;
+  else
+    module->unique_mode = UNIQUE_FALSE;
+
+  panel_debug_filtered (PANEL_DEBUG_MODULE, "new module %s, filename=%s, internal=%s",
+                        name, module->filename,
+                        PANEL_DEBUG_BOOL (module->mode == PANEL_MODULE_RUN_MODE_INTERNAL));
+
+  return module;
+}
+
+
+
 PanelModule *
 panel_module_new_from_desktop_file (const gchar *filename,
                                     const gchar *name,
@@ -297,8 +375,6 @@ panel_module_new_from_desktop_file (const gchar *filename,
   XfceRc *rc;
   const gchar *module_name;
   gchar *path;
-  const gchar *module_unique;
-  gboolean found;
 
   panel_return_val_if_fail (!xfce_str_is_empty (filename), NULL);
   panel_return_val_if_fail (!xfce_str_is_empty (name), NULL);
@@ -335,28 +411,17 @@ panel_module_new_from_desktop_file (const gchar *filename,
   if (G_LIKELY (module_name != NULL))
     {
       path = g_module_build_path (libdir, module_name);
-      found = g_file_test (path, G_FILE_TEST_EXISTS);
 
-      if (G_LIKELY (found))
+      if (G_LIKELY (g_file_test (path, G_FILE_TEST_EXISTS)))
         {
-          /* create new module */
-          module = g_object_new (PANEL_TYPE_MODULE, NULL);
-          module->filename = path;
-
-          /* run mode of the module, by default everything runs in
-           * the wrapper, unless defined otherwise or unsupported */
-          if (forced_mode != PANEL_MODULE_RUN_MODE_INTERNAL
-              && ((WINDOWING_IS_X11 ()
-                   && (forced_mode == PANEL_MODULE_RUN_MODE_EXTERNAL
-                       || !xfce_rc_read_bool_entry (rc, "X-XFCE-Internal", FALSE)))
-                  || (gtk_layer_is_supported () && forced_mode == PANEL_MODULE_RUN_MODE_EXTERNAL)))
-            {
-              module->mode = PANEL_MODULE_RUN_MODE_EXTERNAL;
-              g_free (module->api);
-              module->api = g_strdup (xfce_rc_read_entry (rc, "X-XFCE-API", LIBXFCE4PANEL_VERSION_API));
-            }
-          else
-            module->mode = PANEL_MODULE_RUN_MODE_INTERNAL;
+          module = panel_module_new_internal (name, path,
+                                              xfce_rc_read_entry (rc, "Name", name),
+                                              xfce_rc_read_entry (rc, "Comment", NULL),
+                                              xfce_rc_read_entry_untranslated (rc, "Icon", NULL),
+                                              xfce_rc_read_entry (rc, "X-XFCE-API", LIBXFCE4PANEL_VERSION_API),
+                                              xfce_rc_read_bool_entry (rc, "X-XFCE-Internal", FALSE),
+                                              xfce_rc_read_entry (rc, "X-XFCE-Unique", NULL),
+                                              forced_mode);
         }
       else
         {
@@ -369,31 +434,6 @@ panel_module_new_from_desktop_file (const gchar *filename,
         }
     }
 
-  if (G_LIKELY (module != NULL))
-    {
-      g_type_module_set_name (G_TYPE_MODULE (module), name);
-      panel_assert (module->mode != PANEL_MODULE_RUN_MODE_NONE);
-
-      /* read the remaining information */
-      module->display_name = g_strdup (xfce_rc_read_entry (rc, "Name", name));
-      module->comment = g_strdup (xfce_rc_read_entry (rc, "Comment", NULL));
-      module->icon_name = g_strdup (xfce_rc_read_entry_untranslated (rc, "Icon", NULL));
-
-      module_unique = xfce_rc_read_entry (rc, "X-XFCE-Unique", NULL);
-      if (G_LIKELY (module_unique == NULL))
-        module->unique_mode = UNIQUE_FALSE;
-      else if (strcasecmp (module_unique, "screen") == 0 && WINDOWING_IS_X11 ())
-        module->unique_mode = UNIQUE_SCREEN;
-      else if (strcasecmp (module_unique, "true") == 0)
-        module->unique_mode = UNIQUE_TRUE;
-      else
-        module->unique_mode = UNIQUE_FALSE;
-
-      panel_debug_filtered (PANEL_DEBUG_MODULE, "new module %s, filename=%s, internal=%s",
-                            name, module->filename,
-                            PANEL_DEBUG_BOOL (module->mode == PANEL_MODULE_RUN_MODE_INTERNAL));
-    }
-
   xfce_rc_close (rc);
 
   return module;
@@ -401,6 +441,56 @@ panel_module_new_from_desktop_file (const gchar *filename,
 
 
 
+PanelModule *
+panel_module_new_from_cache_record (GVariant *record,
+                                    PanelModuleRunMode forced_mode)
+{
+  const gchar *name, *filename, *display_name;
+  const gchar *comment, *icon_name, *api, *unique;
+  gboolean internal;
+
+  panel_return_val_if_fail (record != NULL, NULL);
+  panel_return_val_if_fail (g_variant_is_of_type (record, G_VARIANT_TYPE (PANEL_MODULE_CACHE_RECORD_TYPE)), NULL);
+
+  g_variant_get (record, "(&s&s&s&s&s&sb&s)",
+                 &name, &filename, &display_name, &comment,
+                 &icon_name, &api, &internal, &unique);
+
+  /* a broken record is not fatal, the directory is simply rescanned */
+  if (G_UNLIKELY (*name == '\0' || *filename == '\0'))
+    return NULL;
+
+  /* empty strings are stored for unset entries */
+  return panel_module_new_internal (name, g_strdup (filename), display_name,
+                                    *comment != '\0' ? comment : NULL,
+                                    *icon_name != '\0' ? icon_name : NULL,
+                                    *api != '\0' ? api : NULL,
+                                    internal,
+                                    *unique != '\0' ? unique : NULL,
+                                    forced_mode);
+}
+
+
+
+GVariant *
+panel_module_get_cache_record (PanelModule *module)
+{
+  panel_return_val_if_fail (PANEL_IS_MODULE (module), NULL);
+  panel_return_val_if_fail (G_IS_TYPE_MODULE (module), NULL);
+
+  return g_variant_new (PANEL_MODULE_CACHE_RECORD_TYPE,
+                        panel_module_get_name (module),
+                        module->filename,
+                        module->display_name,
+                        module->comment != NULL ? module->comment : "",
+                        module->icon_name != NULL ? module->icon_name : "",
+                        module->desktop_api != NULL ? module->desktop_api : "",
+                        (gboolean) module->desktop_internal,
+                        module->desktop_unique != NULL ? module->desktop_unique : "");
+}
+
+
+
 GtkWidget *
 panel_module_new_plugin (PanelModule *module,
                          GdkScreen *screen,
@@ -409,6 +499,7 @@ panel_module_new_plugin (PanelModule *module,
 {
   GtkWidget *plugin = NULL;
   const gchar *debug_type = NULL;
+  gint64 trace_begin;
 
   panel_return_val_if_fail (PANEL_IS_MODULE (module), NULL);
   panel_return_val_if_fail (G_IS_TYPE_MODULE (module), NULL);
@@ -420,6 +511,8 @@ panel_module_new_plugin (PanelModule *module,
   if (G_UNLIKELY (!panel_module_is_usable (module, screen)))
     return NULL;
 
+  trace_begin = panel_trace_begin ();
+
   switch (module->mode)
     {
     case PANEL_MODULE_RUN_MODE_INTERNAL:
@@ -474,6 +567,9 @@ panel_module_new_plugin (PanelModule *module,
       panel_debug (PANEL_DEBUG_MODULE, "new item (type=%s, name=%s, id=%d)",
                    debug_type, panel_module_get_name (module), unique_id);
 
+      panel_trace_end (trace_begin, "plugin", "construct", panel_module_get_name (module), unique_id);
+      panel_trace_first_draw (plugin, trace_begin, panel_module_get_name (module), unique_id);
+
       /* handle module use count and unloading */
       g_object_weak_ref (G_OBJECT (plugin), panel_module_plugin_destroyed, module);
 
@@ -559,6 +655,16 @@ panel_module_get_api (PanelModule *module)
 
 
 
+PanelModuleRunMode
+panel_module_get_run_mode (PanelModule *module)
+{
+  panel_return_val_if_fail (PANEL_IS_MODULE (module), PANEL_MODULE_RUN_MODE_NONE);
+
+  return module->mode;
+}
+
+
+
 PanelModule *
 panel_module_get_from_plugin_provider (XfcePanelPluginProvider *provider)
 {
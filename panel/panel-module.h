@@ -37,6 +37,9 @@ typedef enum
                                   * with communication through PanelPluginExternal */
 } PanelModuleRunMode;
 
+/* name, filename, display name, comment, icon name, api, internal, unique */
+#define PANEL_MODULE_CACHE_RECORD_TYPE "(ssssssbs)"
+
 
 
 PanelModule *
@@ -45,6 +48,13 @@ panel_module_new_from_desktop_file (const gchar *filename,
                                     const gchar *lib_dir,
                                     PanelModuleRunMode forced_mode) G_GNUC_MALLOC;
 
+PanelModule *
+panel_module_new_from_cache_record (GVariant *record,
+                                    PanelModuleRunMode forced_mode) G_GNUC_MALLOC;
+
+GVariant *
+panel_module_get_cache_record (PanelModule *module);
+
 GtkWidget *
 panel_module_new_plugin (PanelModule *module,
                          GdkScreen *screen,
@@ -69,6 +79,9 @@ panel_module_get_icon_name (PanelModule *module) G_GNUC_PURE;
 const gchar *
 panel_module_get_api (PanelModule *module) G_GNUC_PURE;
 
+PanelModuleRunMode
+panel_module_get_run_mode (PanelModule *module);
+
 PanelModule *
 panel_module_get_from_plugin_provider (XfcePanelPluginProvider *provider);
 
@@ -0,0 +1,741 @@
+/*
+ * Copyright (C) 2026 The Xfce Development Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "panel-plugin-external-host.h"
+
+#include "common/panel-debug.h"
+#include "common/panel-host.h"
+#include "common/panel-private.h"
+#include "libxfce4panel/xfce-panel-plugin-provider.h"
+
+#include <gio/gio.h>
+#include <glib-unix.h>
+#include <libxfce4util/libxfce4util.h>
+
+#include <errno.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifdef HAVE_SYS_WAIT_H
+#include <sys/wait.h>
+#endif
+
+
+
+/* only real wrappers can host plugins, not the ones started in a debugger */
+#define HOST_BIN_PREFIX HELPERDIR G_DIR_SEPARATOR_S "wrapper-"
+
+/* modules that refused to run in a host, one filename per line */
+#define HOST_REFUSED_FILENAME PANEL_PLUGIN_RELATIVE_PATH G_DIR_SEPARATOR_S "host-refused"
+
+
+
+typedef struct _PanelHost PanelHost;
+typedef struct _HostMember HostMember;
+
+/* a wrapper process running the plugins of one host group */
+struct _PanelHost
+{
+  gchar *group;
+  gchar *binary;
+
+  gint socket;
+  GPid pid;
+  guint io_id;
+
+  /* unique id → member, the plugins running in the host */
+  GHashTable *members;
+
+  /* after a crash, members are reported one by one so the answer
+   * to the restart question is asked once for the group */
+  GQueue crashed;
+  HostMember *reporting;
+  gint restart_answer;
+};
+
+/* a plugin in a host, identified by a negative fake pid which
+ * must never be passed to kill() */
+struct _HostMember
+{
+  PanelHost *host;
+  gint unique_id;
+  gchar *filename;
+  GPid pid;
+  GSource *watch;
+  gint status;
+  guint exited : 1;
+};
+
+typedef struct _HostWatch
+{
+  GSource __parent__;
+  GPid pid;
+  gint status;
+} HostWatch;
+
+
+
+static gboolean
+panel_plugin_external_host_watch_dispatch (GSource *source,
+                                           GSourceFunc callback,
+                                           gpointer user_data);
+static void
+panel_plugin_external_host_watch_finalize (GSource *source);
+
+
+
+/* group → PanelHost, hosts are never freed */
+static GHashTable *hosts = NULL;
+
+/* fake pid → HostMember */
+static GHashTable *host_members = NULL;
+static GPid host_last_pid = 0;
+
+/* modules the host refused, they always run standalone */
+static GHashTable *host_refused = NULL;
+
+/* unique id → host group, from the plugin configuration */
+static GHashTable *host_groups = NULL;
+
+static GSourceFuncs host_watch_funcs = {
+  NULL,
+  NULL,
+  panel_plugin_external_host_watch_dispatch,
+  panel_plugin_external_host_watch_finalize,
+};
+
+
+
+static void
+panel_plugin_external_host_member_free (gpointer data)
+{
+  HostMember *member = data;
+
+  g_free (member->filename);
+  g_slice_free (HostMember, member);
+}
+
+
+
+static void
+panel_plugin_external_host_release_next (PanelHost *host)
+{
+  HostMember *member;
+
+  while ((member = g_queue_pop_head (&host->crashed)) != NULL)
+    {
+      if (member->watch != NULL)
+        {
+          host->reporting = member;
+          ((HostWatch *) member->watch)->status = member->status;
+          g_source_set_ready_time (member->watch, 0);
+          return;
+        }
+
+      g_hash_table_remove (host_members, GINT_TO_POINTER (member->pid));
+    }
+}
+
+
+
+static gboolean
+panel_plugin_external_host_watch_dispatch (GSource *source,
+                                           GSourceFunc callback,
+                                           gpointer user_data)
+{
+  HostWatch *watch = (HostWatch *) source;
+  HostMember *member;
+
+  g_source_set_ready_time (source, -1);
+
+  if (callback != NULL)
+    ((GChildWatchFunc) (void (*) (void)) callback) (watch->pid, watch->status, user_data);
+
+  /* the restart question was answered, report the next member */
+  member = g_hash_table_lookup (host_members, GINT_TO_POINTER (watch->pid));
+  if (member != NULL && member->host->reporting == member)
+    {
+      member->host->reporting = NULL;
+      panel_plugin_external_host_release_next (member->host);
+    }
+
+  return G_SOURCE_REMOVE;
+}
+
+
+
+static void
+panel_plugin_external_host_watch_finalize (GSource *source)
+{
+  HostWatch *watch = (HostWatch *) source;
+  HostMember *member;
+  PanelHost *host;
+  gboolean reporting;
+
+  member = g_hash_table_lookup (host_members, GINT_TO_POINTER (watch->pid));
+  if (member == NULL || member->watch != source)
+    return;
+
+  member->watch = NULL;
+  if (!member->exited)
+    return;
+
+  host = member->host;
+  reporting = host->reporting == member;
+  if (reporting)
+    host->reporting = NULL;
+  else
+    g_queue_remove (&host->crashed, member);
+
+  g_hash_table_remove (host_members, GINT_TO_POINTER (watch->pid));
+
+  if (reporting)
+    panel_plugin_external_host_release_next (host);
+}
+
+
+
+static void
+panel_plugin_external_host_close (PanelHost *host)
+{
+  if (host->io_id != 0)
+    g_clear_handle_id (&host->io_id, g_source_remove);
+
+  /* the host quits when it reads the end of file */
+  if (host->socket != -1)
+    {
+      close (host->socket);
+      host->socket = -1;
+    }
+}
+
+
+
+static void
+panel_plugin_external_host_member_exited (HostMember *member,
+                                          gint status,
+                                          gboolean crashed)
+{
+  PanelHost *host = member->host;
+
+  if (member->exited)
+    return;
+
+  member->exited = TRUE;
+  member->status = status;
+  g_hash_table_remove (host->members, GINT_TO_POINTER (member->unique_id));
+
+  if (member->watch == NULL)
+    {
+      g_hash_table_remove (host_members, GINT_TO_POINTER (member->pid));
+    }
+  else if (crashed)
+    {
+      g_queue_push_tail (&host->crashed, member);
+    }
+  else
+    {
+      ((HostWatch *) member->watch)->status = status;
+      g_source_set_ready_time (member->watch, 0);
+    }
+
+  /* nothing left to host */
+  if (!crashed && g_hash_table_size (host->members) == 0)
+    panel_plugin_external_host_close (host);
+}
+
+
+
+static void
+panel_plugin_external_host_lost (PanelHost *host,
+                                 gint status)
+{
+  GList *members, *li;
+
+  panel_plugin_external_host_close (host);
+
+  host->restart_answer = -1;
+
+  members = g_hash_table_get_values (host->members);
+  for (li = members; li != NULL; li = li->next)
+    panel_plugin_external_host_member_exited (li->data, status, TRUE);
+  g_list_free (members);
+
+  if (host->reporting == NULL)
+    panel_plugin_external_host_release_next (host);
+}
+
+
+
+static void
+panel_plugin_external_host_load_refused (void)
+{
+  gchar *filename;
+  gchar *contents;
+  gchar **lines;
+  guint i;
+
+  host_refused = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  filename = xfce_resource_lookup (XFCE_RESOURCE_CACHE, HOST_REFUSED_FILENAME);
+  if (filename == NULL)
+    return;
+
+  if (g_file_get_contents (filename, &contents, NULL, NULL))
+    {
+      lines = g_strsplit (contents, "\n", -1);
+      for (i = 0; lines[i] != NULL; i++)
+        if (*lines[i] != '\0')
+          g_hash_table_add (host_refused, g_strdup (lines[i]));
+
+      g_strfreev (lines);
+      g_free (contents);
+    }
+
+  g_free (filename);
+}
+
+
+
+static void
+panel_plugin_external_host_refuse (const gchar *module)
+{
+  GHashTableIter iter;
+  GString *contents;
+  gchar *filename;
+  gpointer key;
+  GError *error = NULL;
+
+  if (!g_hash_table_add (host_refused, g_strdup (module)))
+    return;
+
+  panel_debug (PANEL_DEBUG_EXTERNAL, "Module \"%s\" refused to run in a host", module);
+
+  /* remember the refusal, so the module is never sent to a host again */
+  filename = xfce_resource_save_location (XFCE_RESOURCE_CACHE, HOST_REFUSED_FILENAME, TRUE);
+  if (filename == NULL)
+    return;
+
+  contents = g_string_new (NULL);
+  g_hash_table_iter_init (&iter, host_refused);
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    g_string_append_printf (contents, "%s\n", (const gchar *) key);
+
+  if (!g_file_set_contents (filename, contents->str, contents->len, &error))
+    {
+      g_warning ("Failed to save %s: %s", filename, error->message);
+      g_error_free (error);
+    }
+
+  g_string_free (contents, TRUE);
+  g_free (filename);
+}
+
+
+
+static gboolean
+panel_plugin_external_host_io (gint fd,
+                               GIOCondition condition,
+                               gpointer data)
+{
+  PanelHost *host = data;
+  PanelHostReply reply;
+  HostMember *member;
+  gssize len;
+
+  for (;;)
+    {
+      len = recv (fd, &reply, sizeof (reply), MSG_DONTWAIT);
+      if (len == sizeof (reply))
+        {
+          member = g_hash_table_lookup (host->members, GINT_TO_POINTER (reply.unique_id));
+          if (member != NULL)
+            {
+              if (WIFEXITED (reply.status) && WEXITSTATUS (reply.status) == PLUGIN_EXIT_NOT_HOSTABLE)
+                panel_plugin_external_host_refuse (member->filename);
+
+              panel_plugin_external_host_member_exited (member, reply.status, FALSE);
+            }
+
+          /* the last member closed the socket */
+          if (host->socket == -1)
+            return G_SOURCE_REMOVE;
+
+          continue;
+        }
+
+      if (len == -1 && errno == EINTR)
+        continue;
+
+      if (len == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return G_SOURCE_CONTINUE;
+
+      break;
+    }
+
+  /* end of file or a broken message, the remaining members are
+   * reported when the host process is reaped */
+  host->io_id = 0;
+  panel_plugin_external_host_close (host);
+  if (host->pid != 0)
+    kill (host->pid, SIGTERM);
+
+  return G_SOURCE_REMOVE;
+}
+
+
+
+static void
+panel_plugin_external_host_exited (GPid pid,
+                                   gint status,
+                                   gpointer data)
+{
+  PanelHost *host = data;
+
+  panel_debug (PANEL_DEBUG_EXTERNAL, "host %s exited with status %d; pid=%d",
+               host->group, status, pid);
+
+  g_spawn_close_pid (pid);
+
+  /* a previous host that was closed after its last member left */
+  if (host->pid != pid)
+    return;
+
+  host->pid = 0;
+  panel_plugin_external_host_lost (host, status);
+}
+
+
+
+static gboolean
+panel_plugin_external_host_start (PanelHost *host,
+                                  gchar **envp,
+                                  GError **error)
+{
+  gchar *argv[] = { host->binary, PANEL_HOST_ARGUMENT, NULL };
+  gint target_fd = PANEL_HOST_SOCKET_FD;
+  gint sv[2];
+  gint errsv;
+
+  if (socketpair (AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) == -1)
+    {
+      errsv = errno;
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                   "Failed to create the host socket: %s", g_strerror (errsv));
+      return FALSE;
+    }
+
+  if (!g_spawn_async_with_pipes_and_fds (NULL, (const gchar *const *) argv,
+                                         (const gchar *const *) envp,
+                                         G_SPAWN_DO_NOT_REAP_CHILD,
+                                         NULL, NULL, -1, -1, -1,
+                                         &sv[1], &target_fd, 1,
+                                         &host->pid, NULL, NULL, NULL, error))
+    {
+      host->pid = 0;
+      close (sv[0]);
+      close (sv[1]);
+      return FALSE;
+    }
+
+  close (sv[1]);
+  host->socket = sv[0];
+
+  host->io_id = g_unix_fd_add (host->socket, G_IO_IN | G_IO_HUP | G_IO_ERR,
+                               panel_plugin_external_host_io, host);
+  g_child_watch_add_full (G_PRIORITY_DEFAULT, host->pid,
+                          panel_plugin_external_host_exited,
+                          host, NULL);
+
+  panel_debug (PANEL_DEBUG_EXTERNAL, "host %s started; pid=%d", host->group, host->pid);
+
+  return TRUE;
+}
+
+
+
+static gboolean
+panel_plugin_external_host_send (PanelHost *host,
+                                 guint command,
+                                 gint unique_id,
+                                 gint signum,
+                                 gchar **argv)
+{
+  const gchar *empty[] = { NULL };
+  GVariant *request;
+  gpointer data;
+  gsize len;
+  gssize n;
+
+  request = g_variant_ref_sink (g_variant_new ("(uii^as)", command, unique_id, signum,
+                                               argv != NULL ? argv : (gchar **) empty));
+  len = g_variant_get_size (request);
+  if (len > PANEL_HOST_MAX_REQUEST)
+    {
+      g_variant_unref (request);
+      errno = EMSGSIZE;
+      return FALSE;
+    }
+
+  data = g_malloc (len);
+  g_variant_store (request, data);
+  g_variant_unref (request);
+
+  do
+    n = send (host->socket, data, len, MSG_NOSIGNAL);
+  while (n == -1 && errno == EINTR);
+  g_free (data);
+
+  return n == (gssize) len;
+}
+
+
+
+void
+panel_plugin_external_host_set_group (gint unique_id,
+                                      const gchar *group)
+{
+  if (group == NULL || *group == '\0')
+    {
+      if (host_groups != NULL)
+        g_hash_table_remove (host_groups, GINT_TO_POINTER (unique_id));
+      return;
+    }
+
+  if (host_groups == NULL)
+    host_groups = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+
+  g_hash_table_insert (host_groups, GINT_TO_POINTER (unique_id), g_strdup (group));
+}
+
+
+
+const gchar *
+panel_plugin_external_host_get_group (gint unique_id)
+{
+  if (host_groups == NULL)
+    return NULL;
+
+  return g_hash_table_lookup (host_groups, GINT_TO_POINTER (unique_id));
+}
+
+
+
+gboolean
+panel_plugin_external_host_spawn (const gchar *group,
+                                  gint unique_id,
+                                  gchar **argv,
+                                  gchar **envp,
+                                  GPid *child_pid,
+                                  GError **error)
+{
+  PanelHost *host;
+  HostMember *member;
+  gint errsv;
+
+  panel_return_val_if_fail (group != NULL && *group != '\0', FALSE);
+  panel_return_val_if_fail (argv != NULL && argv[0] != NULL, FALSE);
+
+  if (!g_str_has_prefix (argv[0], HOST_BIN_PREFIX))
+    {
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                           "Only plain wrappers can host plugins");
+      return FALSE;
+    }
+
+  if (hosts == NULL)
+    {
+      hosts = g_hash_table_new (g_str_hash, g_str_equal);
+      host_members = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+                                            panel_plugin_external_host_member_free);
+      panel_plugin_external_host_load_refused ();
+    }
+
+  if (g_hash_table_contains (host_refused, argv[PLUGIN_ARGV_FILENAME]))
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                   "Module \"%s\" can not run in a host", argv[PLUGIN_ARGV_FILENAME]);
+      return FALSE;
+    }
+
+  host = g_hash_table_lookup (hosts, group);
+  if (host == NULL)
+    {
+      host = g_slice_new0 (PanelHost);
+      host->group = g_strdup (group);
+      host->binary = g_strdup (argv[0]);
+      host->socket = -1;
+      host->members = g_hash_table_new (g_direct_hash, g_direct_equal);
+      host->restart_answer = -1;
+      g_hash_table_insert (hosts, host->group, host);
+    }
+
+  /* plugins with another api version need another wrapper */
+  if (g_strcmp0 (host->binary, argv[0]) != 0)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                   "Host group \"%s\" runs another wrapper", group);
+      return FALSE;
+    }
+
+  if (G_UNLIKELY (g_hash_table_contains (host->members, GINT_TO_POINTER (unique_id))))
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_EXISTS,
+                   "Plugin %d already runs in host group \"%s\"", unique_id, group);
+      return FALSE;
+    }
+
+  if (host->socket == -1 && !panel_plugin_external_host_start (host, envp, error))
+    return FALSE;
+
+  if (!panel_plugin_external_host_send (host, PANEL_HOST_REQUEST_ADD, unique_id, 0, argv))
+    {
+      errsv = errno;
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                   "Failed to send the plugin to host group \"%s\": %s",
+                   group, g_strerror (errsv));
+      return FALSE;
+    }
+
+  member = g_slice_new0 (HostMember);
+  member->host = host;
+  member->unique_id = unique_id;
+  member->filename = g_strdup (argv[PLUGIN_ARGV_FILENAME]);
+  member->pid = --host_last_pid;
+  g_hash_table_insert (host_members, GINT_TO_POINTER (member->pid), member);
+  g_hash_table_insert (host->members, GINT_TO_POINTER (unique_id), member);
+
+  *child_pid = member->pid;
+
+  return TRUE;
+}
+
+
+
+gboolean
+panel_plugin_external_host_kill (GPid pid,
+                                 gint signum)
+{
+  HostMember *member = NULL;
+
+  if (host_members != NULL)
+    member = g_hash_table_lookup (host_members, GINT_TO_POINTER (pid));
+
+  /* a process of its own */
+  if (member == NULL)
+    return FALSE;
+
+  /* the host replies with the signal as status, like the wrapper was killed */
+  if (!member->exited && member->host->socket != -1)
+    panel_plugin_external_host_send (member->host, PANEL_HOST_REQUEST_REMOVE,
+                                     member->unique_id, signum, NULL);
+
+  return TRUE;
+}
+
+
+
+GPid
+panel_plugin_external_host_get_process (GPid pid)
+{
+  HostMember *member = NULL;
+
+  if (host_members != NULL)
+    member = g_hash_table_lookup (host_members, GINT_TO_POINTER (pid));
+
+  /* the fake pid of a member is only a key, show the host process */
+  if (member == NULL)
+    return pid;
+
+  return member->exited ? 0 : member->host->pid;
+}
+
+
+
+guint
+panel_plugin_external_host_child_watch_add (gint priority,
+                                            GPid pid,
+                                            GChildWatchFunc function,
+                                            gpointer data,
+                                            GDestroyNotify notify)
+{
+  HostMember *member = NULL;
+  GSource *source;
+  guint id;
+
+  if (host_members != NULL)
+    member = g_hash_table_lookup (host_members, GINT_TO_POINTER (pid));
+
+  /* a process of its own */
+  if (member == NULL)
+    return g_child_watch_add_full (priority, pid, function, data, notify);
+
+  panel_return_val_if_fail (member->watch == NULL || member->exited, 0);
+
+  source = g_source_new (&host_watch_funcs, sizeof (HostWatch));
+  ((HostWatch *) source)->pid = pid;
+  g_source_set_priority (source, priority);
+  g_source_set_callback (source, (GSourceFunc) (void (*) (void)) function, data, notify);
+  g_source_set_static_name (source, "[xfce4-panel] host member watch");
+  member->watch = source;
+
+  if (member->exited && !g_queue_find (&member->host->crashed, member))
+    {
+      ((HostWatch *) source)->status = member->status;
+      g_source_set_ready_time (source, 0);
+    }
+
+  id = g_source_attach (source, NULL);
+  g_source_unref (source);
+
+  return id;
+}
+
+
+
+gint
+panel_plugin_external_host_get_restart_answer (GPid pid)
+{
+  HostMember *member;
+
+  if (host_members == NULL)
+    return -1;
+
+  member = g_hash_table_lookup (host_members, GINT_TO_POINTER (pid));
+  if (member == NULL)
+    return -1;
+
+  return member->host->restart_answer;
+}
+
+
+
+void
+panel_plugin_external_host_set_restart_answer (GPid pid,
+                                               gboolean restart)
+{
+  HostMember *member;
+
+  if (host_members == NULL)
+    return;
+
+  member = g_hash_table_lookup (host_members, GINT_TO_POINTER (pid));
+  if (member != NULL)
+    member->host->restart_answer = restart;
+}
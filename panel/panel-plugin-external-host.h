@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2026 The Xfce Development Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __PANEL_PLUGIN_EXTERNAL_HOST_H__
+#define __PANEL_PLUGIN_EXTERNAL_HOST_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+void
+panel_plugin_external_host_set_group (gint unique_id,
+                                      const gchar *group);
+
+const gchar *
+panel_plugin_external_host_get_group (gint unique_id);
+
+gboolean
+panel_plugin_external_host_spawn (const gchar *group,
+                                  gint unique_id,
+                                  gchar **argv,
+                                  gchar **envp,
+                                  GPid *child_pid,
+                                  GError **error);
+
+gboolean
+panel_plugin_external_host_kill (GPid pid,
+                                 gint signum);
+
+GPid
+panel_plugin_external_host_get_process (GPid pid);
+
+guint
+panel_plugin_external_host_child_watch_add (gint priority,
+                                            GPid pid,
+                                            GChildWatchFunc function,
+                                            gpointer data,
+                                            GDestroyNotify notify);
+
+gint
+panel_plugin_external_host_get_restart_answer (GPid pid);
+
+void
+panel_plugin_external_host_set_restart_answer (GPid pid,
+                                               gboolean restart);
+
+G_END_DECLS
+
+#endif /* !__PANEL_PLUGIN_EXTERNAL_HOST_H__ */
@@ -216,7 +216,15 @@ panel_plugin_external_wrapper_wayland_spawn (PanelPluginExternal *external,
                                              GPid *pid,
                                              GError **error)
 {
-  return g_spawn_async (NULL, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL, pid, error);
+  gchar **envp;
+  gboolean succeed;
+
+  envp = g_get_environ ();
+  succeed = panel_plugin_external_wrapper_spawn (PANEL_PLUGIN_EXTERNAL_WRAPPER (external),
+                                                 argv, envp, pid, error);
+  g_strfreev (envp);
+
+  return succeed;
 }
 
 
@@ -134,30 +134,25 @@ panel_plugin_external_wrapper_x11_get_argv (PanelPluginExternal *external,
 
 
 
-static void
-panel_plugin_external_wrapper_x11_spawn_child_setup (gpointer data)
+static gboolean
+panel_plugin_external_wrapper_x11_spawn (PanelPluginExternal *external,
+                                         gchar **argv,
+                                         GPid *pid,
+                                         GError **error)
 {
-  PanelPluginExternal *external = PANEL_PLUGIN_EXTERNAL (data);
   GdkDisplay *display;
-  const gchar *name;
+  gchar **envp;
+  gboolean succeed;
 
   /* this is what gdk_spawn_on_screen does */
   display = gtk_widget_get_display (GTK_WIDGET (external));
-  name = gdk_display_get_name (display);
-  g_setenv ("DISPLAY", name, TRUE);
-}
+  envp = g_environ_setenv (g_get_environ (), "DISPLAY", gdk_display_get_name (display), TRUE);
 
+  succeed = panel_plugin_external_wrapper_spawn (PANEL_PLUGIN_EXTERNAL_WRAPPER (external),
+                                                 argv, envp, pid, error);
+  g_strfreev (envp);
 
-
-static gboolean
-panel_plugin_external_wrapper_x11_spawn (PanelPluginExternal *external,
-                                         gchar **argv,
-                                         GPid *pid,
-                                         GError **error)
-{
-  return g_spawn_async (NULL, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD,
-                        panel_plugin_external_wrapper_x11_spawn_child_setup,
-                        external, pid, error);
+  return succeed;
 }
 
 
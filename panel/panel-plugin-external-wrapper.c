@@ -20,7 +20,9 @@
 #include "panel-dialogs.h"
 #include "panel-marshal.h"
 #include "panel-plugin-external-wrapper-exported.h"
+#include "panel-plugin-external-host.h"
 #include "panel-plugin-external-wrapper.h"
+#include "panel-trace.h"
 #include "panel-window.h"
 
 #ifdef ENABLE_X11
@@ -36,6 +38,7 @@
 #include "common/panel-dbus.h"
 #include "common/panel-debug.h"
 #include "common/panel-private.h"
+#include "common/panel-ring.h"
 
 #include <libxfce4util/libxfce4util.h>
 
@@ -43,6 +46,10 @@
 
 #define WRAPPER_BIN HELPERDIR G_DIR_SEPARATOR_S "wrapper"
 
+/* where the wrapper finds the property ring after the spawn */
+#define WRAPPER_RING_SHM_FD 3
+#define WRAPPER_RING_EVENT_FD 4
+
 
 
 #define get_instance_private(instance) \
@@ -92,6 +99,12 @@ typedef struct _PanelPluginExternalWrapperPrivate
   XfcePanelPluginWrapperExported *skeleton;
   GDBusConnection *connection;
 
+  /* shared memory transport for properties, D-Bus is the fallback */
+  PanelRing *ring;
+
+  /* handle → start time of remote events, while tracing */
+  GHashTable *remote_event_traces;
+
   guint show_configure : 1;
   guint show_about : 1;
 } PanelPluginExternalWrapperPrivate;
@@ -235,6 +248,11 @@ panel_plugin_external_wrapper_finalize (GObject *object)
 {
   PanelPluginExternalWrapperPrivate *priv = get_instance_private (object);
 
+  panel_ring_free (priv->ring);
+
+  if (priv->remote_event_traces != NULL)
+    g_hash_table_destroy (priv->remote_event_traces);
+
   if (priv->skeleton != NULL)
     g_object_unref (priv->skeleton);
   if (priv->connection != NULL)
@@ -249,10 +267,12 @@ static gchar **
 panel_plugin_external_wrapper_get_argv (PanelPluginExternal *external,
                                         gchar **arguments)
 {
+  PanelPluginExternalWrapperPrivate *priv = get_instance_private (external);
   PanelModule *module;
   guint i, argc = PLUGIN_ARGV_ARGUMENTS;
   gchar **argv;
   gint unique_id;
+  GError *error = NULL;
 
   panel_return_val_if_fail (PANEL_IS_PLUGIN_EXTERNAL_WRAPPER (external), NULL);
 
@@ -270,6 +290,17 @@ panel_plugin_external_wrapper_get_argv (PanelPluginExternal *external,
   argv[PLUGIN_ARGV_NAME] = g_strdup (panel_module_get_name (module));
   argv[PLUGIN_ARGV_DISPLAY_NAME] = g_strdup (panel_module_get_display_name (module));
   argv[PLUGIN_ARGV_COMMENT] = g_strdup (panel_module_get_comment (module));
+
+  /* a new child gets a new ring, records left for a previous child are stale */
+  panel_ring_free (priv->ring);
+  priv->ring = panel_ring_new (&error);
+  if (priv->ring == NULL)
+    {
+      panel_debug (PANEL_DEBUG_EXTERNAL, "%s-%d: Using D-Bus for properties: %s",
+                   panel_module_get_name (module), unique_id, error->message);
+      g_error_free (error);
+    }
+
   g_object_unref (module);
 
   /* append the arguments */
@@ -284,6 +315,77 @@ panel_plugin_external_wrapper_get_argv (PanelPluginExternal *external,
 
 
 
+gboolean
+panel_plugin_external_wrapper_spawn (PanelPluginExternalWrapper *wrapper,
+                                     gchar **argv,
+                                     gchar **envp,
+                                     GPid *pid,
+                                     GError **error)
+{
+  PanelPluginExternalWrapperPrivate *priv = get_instance_private (wrapper);
+  gint source_fds[2] = { -1, -1 };
+  gint target_fds[2] = { WRAPPER_RING_SHM_FD, WRAPPER_RING_EVENT_FD };
+  gsize n_fds = 0;
+  gchar **child_envp;
+  GError *host_error = NULL;
+  gboolean succeed;
+  const gchar *group;
+  gint unique_id;
+
+  panel_return_val_if_fail (PANEL_IS_PLUGIN_EXTERNAL_WRAPPER (wrapper), FALSE);
+
+  /* plugins in a host group share one wrapper process, the group is
+   * read with the rest of the plugin configuration on startup */
+  g_object_get (wrapper, "unique-id", &unique_id, NULL);
+  group = panel_plugin_external_host_get_group (unique_id);
+
+  succeed = FALSE;
+  if (group != NULL)
+    {
+      succeed = panel_plugin_external_host_spawn (group, unique_id, argv, envp, pid, &host_error);
+      if (!succeed)
+        {
+          panel_debug (PANEL_DEBUG_EXTERNAL, "%d: Not running in a host: %s", unique_id, host_error->message);
+          g_error_free (host_error);
+        }
+    }
+
+  /* the ring is mapped by a single plugin per process, hosted
+   * plugins receive their properties over D-Bus */
+  if (succeed)
+    {
+      g_clear_pointer (&priv->ring, panel_ring_free);
+      return TRUE;
+    }
+
+  child_envp = g_strdupv (envp);
+
+  /* hand the ring over to the child at fixed descriptors */
+  if (priv->ring != NULL)
+    {
+      source_fds[0] = panel_ring_get_shm_fd (priv->ring);
+      source_fds[1] = panel_ring_get_event_fd (priv->ring);
+      n_fds = G_N_ELEMENTS (source_fds);
+      child_envp = g_environ_setenv (child_envp, PANEL_RING_ENVIRONMENT,
+                                     G_STRINGIFY (WRAPPER_RING_SHM_FD) "," G_STRINGIFY (WRAPPER_RING_EVENT_FD),
+                                     TRUE);
+    }
+
+  /* no child setup function, the environment is complete before the fork */
+  succeed = g_spawn_async_with_pipes_and_fds (NULL, (const gchar *const *) argv,
+                                              (const gchar *const *) child_envp,
+                                              G_SPAWN_DO_NOT_REAP_CHILD,
+                                              NULL, NULL, -1, -1, -1,
+                                              source_fds, target_fds, n_fds,
+                                              pid, NULL, NULL, NULL, error);
+
+  g_strfreev (child_envp);
+
+  return succeed;
+}
+
+
+
 static GVariant *
 panel_plugin_external_wrapper_gvalue_prop_to_gvariant (const GValue *value)
 {
@@ -337,6 +439,7 @@ panel_plugin_external_wrapper_set_properties (PanelPluginExternal *external,
   PanelPluginExternalWrapperPrivate *priv = get_instance_private (external);
   GVariantBuilder builder;
   PluginProperty *property;
+  GVariant *parameters;
   GSList *li;
 
   panel_return_if_fail (PANEL_IS_PLUGIN_EXTERNAL_WRAPPER (external));
@@ -359,18 +462,33 @@ panel_plugin_external_wrapper_set_properties (PanelPluginExternal *external,
       else
         {
           g_warning ("Failed to convert wrapper property from gvalue:%s to gvariant", G_VALUE_TYPE_NAME (&property->value));
+          g_variant_builder_clear (&builder);
           return;
         }
     }
 
-  /* send array to the wrapper */
-  g_dbus_connection_emit_signal (priv->connection,
-                                 NULL,
-                                 g_dbus_interface_skeleton_get_object_path (G_DBUS_INTERFACE_SKELETON (priv->skeleton)),
-                                 PANEL_DBUS_WRAPPER_INTERFACE,
-                                 "Set",
-                                 g_variant_builder_end (&builder),
-                                 NULL);
+  parameters = g_variant_ref_sink (g_variant_builder_end (&builder));
+
+  /* send array to the wrapper, through the ring if the child attached to it */
+  if (priv->ring != NULL && !panel_ring_push (priv->ring, parameters))
+    {
+      /* the wrapper drains the ring before handling a D-Bus signal, so once
+       * a set went over D-Bus later ones must too, or they would be applied
+       * before it */
+      panel_debug (PANEL_DEBUG_EXTERNAL, "Ring not usable, sending properties over D-Bus");
+      g_clear_pointer (&priv->ring, panel_ring_free);
+    }
+
+  if (priv->ring == NULL)
+    g_dbus_connection_emit_signal (priv->connection,
+                                   NULL,
+                                   g_dbus_interface_skeleton_get_object_path (G_DBUS_INTERFACE_SKELETON (priv->skeleton)),
+                                   PANEL_DBUS_WRAPPER_INTERFACE,
+                                   "Set",
+                                   parameters,
+                                   NULL);
+
+  g_variant_unref (parameters);
 }
 
 
@@ -384,6 +502,7 @@ panel_plugin_external_wrapper_remote_event (PanelPluginExternal *external,
   PanelPluginExternalWrapperPrivate *priv = get_instance_private (external);
   GVariant *variant;
   static guint handle_counter = 0;
+  gint64 trace_begin;
 
   panel_return_val_if_fail (PANEL_IS_PLUGIN_EXTERNAL_WRAPPER (external), TRUE);
   panel_return_val_if_fail (XFCE_IS_PANEL_PLUGIN_PROVIDER (external), TRUE);
@@ -403,6 +522,16 @@ panel_plugin_external_wrapper_remote_event (PanelPluginExternal *external,
       variant = g_variant_new_variant (g_variant_new_byte ('\0'));
     }
 
+  /* the round trip ends when the wrapper sends the result */
+  trace_begin = panel_trace_begin ();
+  if (trace_begin != 0)
+    {
+      if (priv->remote_event_traces == NULL)
+        priv->remote_event_traces = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+      g_hash_table_insert (priv->remote_event_traces, GUINT_TO_POINTER (*handle),
+                           g_memdup2 (&trace_begin, sizeof (trace_begin)));
+    }
+
   g_dbus_connection_emit_signal (priv->connection,
                                  NULL,
                                  g_dbus_interface_skeleton_get_object_path (G_DBUS_INTERFACE_SKELETON (priv->skeleton)),
@@ -482,8 +611,22 @@ panel_plugin_external_wrapper_dbus_remote_event_result (XfcePanelPluginWrapperEx
                                                         gboolean result,
                                                         PanelPluginExternalWrapper *wrapper)
 {
+  PanelPluginExternalWrapperPrivate *priv = get_instance_private (wrapper);
+  PanelModule *module;
+  gint64 *trace_begin;
+  gint unique_id;
+
   panel_return_val_if_fail (PANEL_IS_PLUGIN_EXTERNAL (wrapper), FALSE);
 
+  if (priv->remote_event_traces != NULL
+      && (trace_begin = g_hash_table_lookup (priv->remote_event_traces, GUINT_TO_POINTER (handle))) != NULL)
+    {
+      g_object_get (wrapper, "module", &module, "unique-id", &unique_id, NULL);
+      panel_trace_end (*trace_begin, "ipc", "RemoteEvent", panel_module_get_name (module), unique_id);
+      g_hash_table_remove (priv->remote_event_traces, GUINT_TO_POINTER (handle));
+      g_object_unref (module);
+    }
+
   g_signal_emit (G_OBJECT (wrapper), external_signals[REMOTE_EVENT_RESULT], 0,
                  handle, result);
 
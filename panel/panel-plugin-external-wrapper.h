@@ -37,6 +37,13 @@ panel_plugin_external_wrapper_new (PanelModule *module,
                                    gint unique_id,
                                    gchar **arguments) G_GNUC_MALLOC;
 
+gboolean
+panel_plugin_external_wrapper_spawn (PanelPluginExternalWrapper *wrapper,
+                                     gchar **argv,
+                                     gchar **envp,
+                                     GPid *pid,
+                                     GError **error);
+
 G_END_DECLS
 
 #endif /* !__PANEL_PLUGIN_EXTERNAL_WRAPPER_H__ */
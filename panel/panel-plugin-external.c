@@ -18,7 +18,9 @@
 
 #include "panel-dialogs.h"
 #include "panel-module.h"
+#include "panel-plugin-external-host.h"
 #include "panel-plugin-external.h"
+#include "panel-trace.h"
 
 #include "common/panel-dbus.h"
 #include "common/panel-debug.h"
@@ -54,8 +56,12 @@ static void
 panel_plugin_external_realize (GtkWidget *widget);
 static void
 panel_plugin_external_unrealize (GtkWidget *widget);
+static void
+panel_plugin_external_child_kill (PanelPluginExternal *external,
+                                  gint signum);
 static gboolean
-panel_plugin_external_child_ask_restart (PanelPluginExternal *external);
+panel_plugin_external_child_ask_restart (PanelPluginExternal *external,
+                                         GPid pid);
 static void
 panel_plugin_external_child_spawn (PanelPluginExternal *external);
 static void
@@ -129,8 +135,10 @@ typedef struct _PanelPluginExternalPrivate
 
   guint embedded : 1;
 
-  /* dbus message queue */
+  /* dbus message queue, flushed once per frame */
   GSList *queue;
+  guint queue_tick_id;
+  gint64 queue_trace_begin;
 
   /* auto restart timer */
   GTimer *restart_timer;
@@ -138,6 +146,7 @@ typedef struct _PanelPluginExternalPrivate
   /* child watch data */
   GPid pid;
   guint watch_id;
+  gint64 spawn_trace_begin;
 
   /* delayed spawning */
   guint spawn_timeout_id;
@@ -275,9 +284,9 @@ panel_plugin_external_finalize (GObject *object)
       /* remove the child watch and don't leave zombies */
       g_clear_handle_id (&priv->watch_id, g_source_remove);
       if (priv->pid != 0)
-        g_child_watch_add (priv->pid,
-                           (GChildWatchFunc) (void (*) (void)) g_spawn_close_pid,
-                           NULL);
+        panel_plugin_external_host_child_watch_add (G_PRIORITY_DEFAULT, priv->pid,
+                                                    (GChildWatchFunc) (void (*) (void)) g_spawn_close_pid,
+                                                    NULL, NULL);
     }
 
   g_clear_slist (&priv->queue, plugin_property_free);
@@ -393,7 +402,7 @@ panel_plugin_external_unrealize (GtkWidget *widget)
       if (priv->embedded)
         panel_plugin_external_queue_add_action (external, PROVIDER_PROP_TYPE_ACTION_QUIT);
       else
-        kill (priv->pid, SIGTERM);
+        panel_plugin_external_child_kill (external, SIGTERM);
     }
 
   panel_debug (PANEL_DEBUG_EXTERNAL,
@@ -406,6 +415,21 @@ panel_plugin_external_unrealize (GtkWidget *widget)
 
 
 
+static void
+panel_plugin_external_child_kill (PanelPluginExternal *external,
+                                  gint signum)
+{
+  PanelPluginExternalPrivate *priv = get_instance_private (external);
+
+  panel_return_if_fail (priv->pid != 0);
+
+  /* a plugin in a host process is only removed from the host */
+  if (!panel_plugin_external_host_kill (priv->pid, signum))
+    kill (priv->pid, signum);
+}
+
+
+
 static gboolean
 panel_plugin_external_child_ask_restart_dialog (GtkWindow *parent,
                                                 const gchar *plugin_name)
@@ -449,34 +473,48 @@ panel_plugin_external_remove (gpointer data)
 
 
 static gboolean
-panel_plugin_external_child_ask_restart (PanelPluginExternal *external)
+panel_plugin_external_child_ask_restart (PanelPluginExternal *external,
+                                         GPid pid)
 {
   PanelPluginExternalPrivate *priv = get_instance_private (external);
   GtkWidget *toplevel;
+  gint answer;
 
   panel_return_val_if_fail (PANEL_IS_PLUGIN_EXTERNAL (external), FALSE);
 
   toplevel = gtk_widget_get_toplevel (GTK_WIDGET (external));
   panel_return_val_if_fail (PANEL_IS_WINDOW (toplevel), FALSE);
 
-  if (priv->restart_timer == NULL
-      || g_timer_elapsed (priv->restart_timer, NULL) > PANEL_PLUGIN_AUTO_RESTART)
+  /* plugins that crashed with their host follow the answer given for the group */
+  answer = panel_plugin_external_host_get_restart_answer (pid);
+  if (answer == -1)
     {
-      g_message ("Plugin %s-%d has been automatically restarted after crash.",
-                 panel_module_get_name (priv->module),
-                 priv->unique_id);
+      if (priv->restart_timer == NULL
+          || g_timer_elapsed (priv->restart_timer, NULL) > PANEL_PLUGIN_AUTO_RESTART)
+        {
+          g_message ("Plugin %s-%d has been automatically restarted after crash.",
+                     panel_module_get_name (priv->module),
+                     priv->unique_id);
+          answer = TRUE;
+        }
+      else
+        {
+          answer = panel_plugin_external_child_ask_restart_dialog (GTK_WINDOW (toplevel),
+                                                                   panel_module_get_display_name (priv->module));
+          panel_plugin_external_host_set_restart_answer (pid, answer);
+        }
     }
-  else if (!panel_plugin_external_child_ask_restart_dialog (GTK_WINDOW (toplevel),
-                                                            panel_module_get_display_name (priv->module)))
+
+  if (!answer)
     {
       if (priv->watch_id != 0)
         {
           /* remove the child watch and don't leave zombies */
           g_clear_handle_id (&priv->watch_id, g_source_remove);
           if (priv->pid != 0)
-            g_child_watch_add (priv->pid,
-                               (GChildWatchFunc) (void (*) (void)) g_spawn_close_pid,
-                               NULL);
+            panel_plugin_external_host_child_watch_add (G_PRIORITY_DEFAULT, priv->pid,
+                                                        (GChildWatchFunc) (void (*) (void)) g_spawn_close_pid,
+                                                        NULL, NULL);
         }
 
       /* delay this until we get out of any other idle func, as this triggers the
@@ -592,6 +630,7 @@ panel_plugin_external_child_spawn (PanelPluginExternal *external)
     }
 
   /* spawn the proccess */
+  priv->spawn_trace_begin = panel_trace_begin ();
   succeed = PANEL_PLUGIN_EXTERNAL_GET_CLASS (external)->spawn (external, argv, &pid, &error);
 
   panel_debug (PANEL_DEBUG_EXTERNAL,
@@ -603,9 +642,10 @@ panel_plugin_external_child_spawn (PanelPluginExternal *external)
     {
       /* watch the child */
       priv->pid = pid;
-      priv->watch_id = g_child_watch_add_full (G_PRIORITY_LOW, pid,
-                                               panel_plugin_external_child_watch, external,
-                                               panel_plugin_external_child_watch_destroyed);
+      /* also handles plugins in a host */
+      priv->watch_id = panel_plugin_external_host_child_watch_add (G_PRIORITY_LOW, pid,
+                                                                   panel_plugin_external_child_watch, external,
+                                                                   panel_plugin_external_child_watch_destroyed);
     }
   else
     {
@@ -724,6 +764,11 @@ panel_plugin_external_child_watch (GPid pid,
           /* do nothing, maybe we try to restart */
           break;
 
+        case PLUGIN_EXIT_NOT_HOSTABLE:
+          /* the host refused the plugin, the next spawn runs it standalone */
+          auto_restart = TRUE;
+          break;
+
         case PLUGIN_EXIT_ARGUMENTS_FAILED:
         case PLUGIN_EXIT_PREINIT_FAILED:
         case PLUGIN_EXIT_CHECK_FAILED:
@@ -751,7 +796,7 @@ panel_plugin_external_child_watch (GPid pid,
     }
 
   if (gtk_widget_get_realized (GTK_WIDGET (external))
-      && (auto_restart || panel_plugin_external_child_ask_restart (external)))
+      && (auto_restart || panel_plugin_external_child_ask_restart (external, pid)))
     {
       panel_plugin_external_child_respawn_schedule (external);
     }
@@ -777,6 +822,12 @@ panel_plugin_external_queue_send_to_child (PanelPluginExternal *external)
 
   panel_return_if_fail (PANEL_IS_PLUGIN_EXTERNAL (external));
 
+  if (priv->queue_tick_id != 0)
+    {
+      gtk_widget_remove_tick_callback (GTK_WIDGET (external), priv->queue_tick_id);
+      priv->queue_tick_id = 0;
+    }
+
   if (priv->queue != NULL)
     {
       priv->queue = g_slist_reverse (priv->queue);
@@ -784,6 +835,11 @@ panel_plugin_external_queue_send_to_child (PanelPluginExternal *external)
       (*PANEL_PLUGIN_EXTERNAL_GET_CLASS (external)->set_properties) (external, priv->queue);
 
       g_clear_slist (&priv->queue, plugin_property_free);
+
+      /* from the first queued property until it left the panel */
+      panel_trace_end (priv->queue_trace_begin, "ipc", "Set",
+                       panel_module_get_name (priv->module), priv->unique_id);
+      priv->queue_trace_begin = 0;
     }
 }
 
@@ -1089,6 +1145,55 @@ panel_plugin_external_set_sensitive (PanelPluginExternal *external)
 
 
 
+static gint
+panel_plugin_external_queue_slot (XfcePanelPluginProviderPropType type)
+{
+  switch (type)
+    {
+    case PROVIDER_PROP_TYPE_SET_SIZE:
+    case PROVIDER_PROP_TYPE_SET_ICON_SIZE:
+    case PROVIDER_PROP_TYPE_SET_DARK_MODE:
+    case PROVIDER_PROP_TYPE_SET_MODE:
+    case PROVIDER_PROP_TYPE_SET_SCREEN_POSITION:
+    case PROVIDER_PROP_TYPE_SET_BACKGROUND_ALPHA:
+    case PROVIDER_PROP_TYPE_SET_NROWS:
+    case PROVIDER_PROP_TYPE_SET_LOCKED:
+    case PROVIDER_PROP_TYPE_SET_SENSITIVE:
+    case PROVIDER_PROP_TYPE_SET_OPACITY:
+    case PROVIDER_PROP_TYPE_SET_MONITOR:
+    case PROVIDER_PROP_TYPE_SET_GEOMETRY:
+      return type;
+
+    /* these all replace the plug background, so only the last one matters */
+    case PROVIDER_PROP_TYPE_SET_BACKGROUND_COLOR:
+    case PROVIDER_PROP_TYPE_SET_BACKGROUND_IMAGE:
+    case PROVIDER_PROP_TYPE_ACTION_BACKGROUND_UNSET:
+      return PROVIDER_PROP_TYPE_ACTION_BACKGROUND_UNSET;
+
+    /* actions and events are never merged */
+    default:
+      return -1;
+    }
+}
+
+
+
+static gboolean
+panel_plugin_external_queue_tick (GtkWidget *widget,
+                                  GdkFrameClock *frame_clock,
+                                  gpointer user_data)
+{
+  PanelPluginExternalPrivate *priv = get_instance_private (widget);
+
+  priv->queue_tick_id = 0;
+  if (priv->embedded)
+    panel_plugin_external_queue_send_to_child (PANEL_PLUGIN_EXTERNAL (widget));
+
+  return G_SOURCE_REMOVE;
+}
+
+
+
 void
 panel_plugin_external_queue_add (PanelPluginExternal *external,
                                  XfcePanelPluginProviderPropType type,
@@ -1096,10 +1201,37 @@ panel_plugin_external_queue_add (PanelPluginExternal *external,
 {
   PanelPluginExternalPrivate *priv = get_instance_private (external);
   PluginProperty *prop;
+  GSList *li;
+  gint slot, prop_slot;
 
   panel_return_if_fail (PANEL_IS_PLUGIN_EXTERNAL (external));
   panel_return_if_fail (G_TYPE_CHECK_VALUE (value));
 
+  /* drop an older value for the same state, the queue only holds deltas;
+   * actions are ordering barriers, so only look at the values after the
+   * last queued action (the queue is in reverse order) */
+  slot = panel_plugin_external_queue_slot (type);
+  if (slot != -1)
+    {
+      for (li = priv->queue; li != NULL; li = li->next)
+        {
+          prop = li->data;
+          prop_slot = panel_plugin_external_queue_slot (prop->type);
+          if (prop_slot == -1)
+            break;
+
+          if (prop_slot == slot)
+            {
+              priv->queue = g_slist_delete_link (priv->queue, li);
+              plugin_property_free (prop);
+              break;
+            }
+        }
+    }
+
+  if (priv->queue == NULL)
+    priv->queue_trace_begin = panel_trace_begin ();
+
   prop = g_slice_new0 (PluginProperty);
   prop->type = type;
   g_value_init (&prop->value, G_VALUE_TYPE (value));
@@ -1107,8 +1239,22 @@ panel_plugin_external_queue_add (PanelPluginExternal *external,
 
   priv->queue = g_slist_prepend (priv->queue, prop);
 
-  if (priv->embedded)
-    panel_plugin_external_queue_send_to_child (external);
+  if (!priv->embedded)
+    return;
+
+  /* state changes are sent together on the next frame of the panel window,
+   * actions go out immediately, preceded by the pending state */
+  if (slot != -1 && gtk_widget_get_mapped (GTK_WIDGET (external)))
+    {
+      if (priv->queue_tick_id == 0)
+        priv->queue_tick_id = gtk_widget_add_tick_callback (GTK_WIDGET (external),
+                                                            panel_plugin_external_queue_tick,
+                                                            NULL, NULL);
+    }
+  else
+    {
+      panel_plugin_external_queue_send_to_child (external);
+    }
 }
 
 
@@ -1148,7 +1294,7 @@ panel_plugin_external_restart (PanelPluginExternal *external)
       if (priv->embedded)
         panel_plugin_external_queue_add_action (external, PROVIDER_PROP_TYPE_ACTION_QUIT_FOR_RESTART);
       else
-        kill (priv->pid, SIGUSR1);
+        panel_plugin_external_child_kill (external, SIGUSR1);
     }
 }
 
@@ -1250,6 +1396,10 @@ panel_plugin_external_set_embedded (PanelPluginExternal *external,
                    priv->unique_id,
                    g_slist_length (priv->queue));
 
+      panel_trace_end (priv->spawn_trace_begin, "external", "spawn-to-embed",
+                       panel_module_get_name (priv->module), priv->unique_id);
+      priv->spawn_trace_begin = 0;
+
       /* send queue to wrapper */
       panel_plugin_external_queue_send_to_child (external);
     }
@@ -1269,5 +1419,6 @@ panel_plugin_external_get_pid (PanelPluginExternal *external)
 {
   panel_return_val_if_fail (PANEL_IS_PLUGIN_EXTERNAL (external), 0);
 
-  return get_instance_private (external)->pid;
+  /* hosted plugins share the process of their host */
+  return panel_plugin_external_host_get_process (get_instance_private (external)->pid);
 }
@@ -0,0 +1,235 @@
+/*
+ * Copyright (C) 2026 The Xfce Development Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "panel-trace.h"
+
+#include "common/panel-debug.h"
+#include "common/panel-private.h"
+
+#include <unistd.h>
+
+
+
+/* number of spans kept, older ones are overwritten */
+#define TRACE_MAX_SPANS (16 * 1024)
+
+
+
+typedef struct _TraceSpan
+{
+  gint64 begin;
+  gint64 duration;
+  const gchar *category;
+  const gchar *name;
+  const gchar *plugin_name;
+  gint unique_id;
+} TraceSpan;
+
+typedef struct _TraceFirstDraw
+{
+  gint64 begin;
+  const gchar *plugin_name;
+  gint unique_id;
+} TraceFirstDraw;
+
+
+
+static TraceSpan *trace_spans = NULL;
+static guint trace_n_spans = 0;
+static guint trace_next = 0;
+
+
+
+gint64
+panel_trace_begin (void)
+{
+  /* spans are only recorded with PANEL_DEBUG=trace */
+  if (!panel_debug_has_domain (PANEL_DEBUG_TRACE))
+    return 0;
+
+  return g_get_monotonic_time ();
+}
+
+
+
+void
+panel_trace_end (gint64 begin,
+                 const gchar *category,
+                 const gchar *name,
+                 const gchar *plugin_name,
+                 gint unique_id)
+{
+  TraceSpan *span;
+
+  panel_return_if_fail (category != NULL);
+  panel_return_if_fail (name != NULL);
+
+  /* tracing was disabled when the span started */
+  if (begin == 0)
+    return;
+
+  if (G_UNLIKELY (trace_spans == NULL))
+    trace_spans = g_new0 (TraceSpan, TRACE_MAX_SPANS);
+
+  span = &trace_spans[trace_next];
+  span->begin = begin;
+  span->duration = g_get_monotonic_time () - begin;
+  span->category = g_intern_string (category);
+  span->name = g_intern_string (name);
+  span->plugin_name = g_intern_string (plugin_name);
+  span->unique_id = unique_id;
+
+  trace_next = (trace_next + 1) % TRACE_MAX_SPANS;
+  trace_n_spans = MIN (trace_n_spans + 1, TRACE_MAX_SPANS);
+
+  panel_debug_filtered (PANEL_DEBUG_TRACE, "%s %s %s-%d: %" G_GINT64_FORMAT " us",
+                        category, name, plugin_name != NULL ? plugin_name : "panel",
+                        unique_id, span->duration);
+}
+
+
+
+static gboolean
+panel_trace_first_draw_cb (GtkWidget *widget,
+                           cairo_t *cr,
+                           TraceFirstDraw *first_draw)
+{
+  panel_trace_end (first_draw->begin, "plugin", "first-draw",
+                   first_draw->plugin_name, first_draw->unique_id);
+
+  g_signal_handlers_disconnect_by_func (widget, panel_trace_first_draw_cb, first_draw);
+
+  return FALSE;
+}
+
+
+
+static void
+panel_trace_first_draw_free (gpointer data,
+                             GClosure *closure)
+{
+  g_slice_free (TraceFirstDraw, data);
+}
+
+
+
+void
+panel_trace_first_draw (GtkWidget *widget,
+                        gint64 begin,
+                        const gchar *plugin_name,
+                        gint unique_id)
+{
+  TraceFirstDraw *first_draw;
+
+  panel_return_if_fail (GTK_IS_WIDGET (widget));
+
+  if (begin == 0)
+    return;
+
+  first_draw = g_slice_new (TraceFirstDraw);
+  first_draw->begin = begin;
+  first_draw->plugin_name = g_intern_string (plugin_name);
+  first_draw->unique_id = unique_id;
+
+  g_signal_connect_data (widget, "draw", G_CALLBACK (panel_trace_first_draw_cb),
+                         first_draw, panel_trace_first_draw_free, G_CONNECT_AFTER);
+}
+
+
+
+static void
+panel_trace_append_string (GString *json,
+                           const gchar *str)
+{
+  gchar *valid = NULL;
+  const gchar *p;
+
+  /* a quoted json string, names come from plugins and can contain anything */
+  if (!g_utf8_validate (str, -1, NULL))
+    str = valid = g_utf8_make_valid (str, -1);
+
+  g_string_append_c (json, '"');
+  for (p = str; *p != '\0'; p++)
+    {
+      switch (*p)
+        {
+        case '"':
+          g_string_append (json, "\\\"");
+          break;
+
+        case '\\':
+          g_string_append (json, "\\\\");
+          break;
+
+        case '\n':
+          g_string_append (json, "\\n");
+          break;
+
+        case '\t':
+          g_string_append (json, "\\t");
+          break;
+
+        default:
+          if ((guchar) *p < 0x20)
+            g_string_append_printf (json, "\\u%04x", (guint) *p);
+          else
+            g_string_append_c (json, *p);
+          break;
+        }
+    }
+  g_string_append_c (json, '"');
+
+  g_free (valid);
+}
+
+
+
+gchar *
+panel_trace_to_json (void)
+{
+  GString *json;
+  TraceSpan *span;
+  guint i, first;
+
+  /* chrome trace event format, complete events in microseconds with
+   * a row (tid) per plugin */
+  json = g_string_new ("{\"traceEvents\":[");
+
+  first = (trace_next + TRACE_MAX_SPANS - trace_n_spans) % TRACE_MAX_SPANS;
+  for (i = 0; i < trace_n_spans; i++)
+    {
+      span = &trace_spans[(first + i) % TRACE_MAX_SPANS];
+      g_string_append (json, i > 0 ? ",{\"name\":" : "{\"name\":");
+      panel_trace_append_string (json, span->name);
+      g_string_append (json, ",\"cat\":");
+      panel_trace_append_string (json, span->category);
+      g_string_append_printf (json,
+                              ",\"ph\":\"X\","
+                              "\"ts\":%" G_GINT64_FORMAT ",\"dur\":%" G_GINT64_FORMAT ","
+                              "\"pid\":%d,\"tid\":%d,"
+                              "\"args\":{\"plugin\":",
+                              span->begin, span->duration,
+                              (gint) getpid (), MAX (span->unique_id, 0));
+      panel_trace_append_string (json, span->plugin_name != NULL ? span->plugin_name : "");
+      g_string_append_printf (json, ",\"unique-id\":%d}}", span->unique_id);
+    }
+
+  g_string_append (json, "],\"displayTimeUnit\":\"ms\"}");
+
+  return g_string_free (json, FALSE);
+}
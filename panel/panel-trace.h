@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2026 The Xfce Development Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __PANEL_TRACE_H__
+#define __PANEL_TRACE_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+gint64
+panel_trace_begin (void);
+
+void
+panel_trace_end (gint64 begin,
+                 const gchar *category,
+                 const gchar *name,
+                 const gchar *plugin_name,
+                 gint unique_id);
+
+void
+panel_trace_first_draw (GtkWidget *widget,
+                        gint64 begin,
+                        const gchar *plugin_name,
+                        gint unique_id);
+
+gchar *
+panel_trace_to_json (void) G_GNUC_MALLOC;
+
+G_END_DECLS
+
+#endif /* !__PANEL_TRACE_H__ */
@@ -19,9 +19,11 @@
 #include "panel-dbus-service.h"
 #include "panel-dialogs.h"
 #include "panel-item-dialog.h"
+#include "panel-layout.h"
 #include "panel-plugin-external.h"
 #include "panel-preferences-dialog.h"
 #include "panel-tic-tac-toe.h"
+#include "panel-trace.h"
 #include "panel-window.h"
 
 #include "common/panel-debug.h"
@@ -47,12 +49,12 @@
 
 
 
-#define SNAP_DISTANCE (10)
 #define DEFAULT_POPUP_DELAY (225)
 #define DEFAULT_POPDOWN_DELAY (350)
 #define MIN_AUTOHIDE_SIZE (1)
 #define DEFAULT_AUTOHIDE_SIZE (3)
 #define DEFAULT_POPDOWN_SPEED (25)
+#define POPDOWN_SPEED_DURATION (10) /* ms of animation per popdown-speed unit */
 #define HANDLE_SPACING (4)
 #define HANDLE_DOTS (2)
 #define HANDLE_PIXELS (2)
@@ -66,7 +68,6 @@
 typedef enum _StrutsEdge StrutsEdge;
 typedef enum _AutohideBehavior AutohideBehavior;
 typedef enum _AutohideState AutohideState;
-typedef enum _SnapPosition SnapPosition;
 typedef enum _PluginProp PluginProp;
 
 
@@ -88,6 +89,8 @@ panel_window_finalize (GObject *object);
 static gboolean
 panel_window_draw (GtkWidget *widget,
                    cairo_t *cr);
+static void
+panel_window_chrome_invalidate (PanelWindow *window);
 static gboolean
 panel_window_delete_event (GtkWidget *widget,
                            GdkEventAny *event);
@@ -172,37 +175,24 @@ panel_window_screen_struts_edge (PanelWindow *window);
 static void
 panel_window_screen_struts_set (PanelWindow *window);
 static void
+panel_window_screen_struts_queue (PanelWindow *window);
+static void
 panel_window_screen_update_borders (PanelWindow *window);
-static SnapPosition
-panel_window_snap_position (PanelWindow *window);
 static void
 panel_window_layer_set_anchor (PanelWindow *window);
 static void
 panel_window_screen_layout_changed (XfwScreen *screen,
                                     PanelWindow *window);
 static void
-panel_window_active_window_changed (XfwScreen *screen,
-                                    XfwWindow *previous_window,
-                                    PanelWindow *window);
-static void
-panel_window_active_window_geometry_changed (XfwWindow *active_window,
-                                             PanelWindow *window);
-static void
-panel_window_active_window_state_changed (XfwWindow *active_window,
-                                          XfwWindowState changed,
-                                          XfwWindowState new,
-                                          PanelWindow *window);
-static void
-panel_window_active_window_monitors (XfwWindow *active_window,
-                                     GParamSpec *pspec,
-                                     PanelWindow *window);
+panel_window_screen_monitors_changed (XfwScreen *screen,
+                                      PanelWindow *window);
 static void
 panel_window_xfw_window_closed (XfwWindow *xfw_window,
                                 PanelWindow *window);
 static void
 panel_window_autohide_timeout_destroy (gpointer user_data);
 static void
-panel_window_autohide_ease_out_timeout_destroy (gpointer user_data);
+panel_window_autohide_ease_out_destroy (gpointer user_data);
 static void
 panel_window_autohide_queue (PanelWindow *window,
                              AutohideState new_state);
@@ -210,7 +200,9 @@ static void
 panel_window_opacity_enter_queue (PanelWindow *window,
                                   gboolean enter);
 static gboolean
-panel_window_autohide_ease_out (gpointer data);
+panel_window_autohide_ease_out (GtkWidget *widget,
+                                GdkFrameClock *frame_clock,
+                                gpointer user_data);
 static void
 panel_window_set_autohide_behavior (PanelWindow *window,
                                     AutohideBehavior behavior);
@@ -223,7 +215,13 @@ panel_window_menu_popup (PanelWindow *window,
                          gboolean show_tic_tac_toe);
 static void
 panel_window_plugins_update (PanelWindow *window,
-                             PluginProp prop);
+                             PluginProp props);
+static void
+panel_window_plugins_queue_update (PanelWindow *window,
+                                   PluginProp props);
+static void
+panel_window_plugin_update (GtkWidget *widget,
+                            gpointer user_data);
 static void
 panel_window_plugin_emit_hidden_event (GtkWidget *widget,
                                        gpointer user_data);
@@ -272,13 +270,13 @@ enum
 
 enum _PluginProp
 {
-  PLUGIN_PROP_HIDDEN_EVENT,
-  PLUGIN_PROP_MODE,
-  PLUGIN_PROP_SCREEN_POSITION,
-  PLUGIN_PROP_NROWS,
-  PLUGIN_PROP_SIZE,
-  PLUGIN_PROP_ICON_SIZE,
-  PLUGIN_PROP_DARK_MODE
+  PLUGIN_PROP_HIDDEN_EVENT = 1 << 0,
+  PLUGIN_PROP_MODE = 1 << 1,
+  PLUGIN_PROP_SCREEN_POSITION = 1 << 2,
+  PLUGIN_PROP_NROWS = 1 << 3,
+  PLUGIN_PROP_SIZE = 1 << 4,
+  PLUGIN_PROP_ICON_SIZE = 1 << 5,
+  PLUGIN_PROP_DARK_MODE = 1 << 6
 };
 
 enum _AutohideBehavior
@@ -297,38 +295,6 @@ enum _AutohideState
   AUTOHIDE_POPUP, /* invisible, but show timeout is running */
 };
 
-enum _SnapPosition
-{
-  /* no snapping */
-  SNAP_POSITION_NONE, /* snapping */
-
-  /* right edge */
-  SNAP_POSITION_E, /* right */
-  SNAP_POSITION_NE, /* top right */
-  SNAP_POSITION_EC, /* right center */
-  SNAP_POSITION_SE, /* bottom right */
-
-  /* left edge */
-  SNAP_POSITION_W, /* left */
-  SNAP_POSITION_NW, /* top left */
-  SNAP_POSITION_WC, /* left center */
-  SNAP_POSITION_SW, /* bottom left */
-
-  /* top and bottom */
-  SNAP_POSITION_NC, /* top center */
-  SNAP_POSITION_SC, /* bottom center */
-  SNAP_POSITION_N, /* top */
-  SNAP_POSITION_S, /* bottom */
-};
-
-enum
-{
-  EDGE_GRAVITY_NONE = 0,
-  EDGE_GRAVITY_START = (SNAP_POSITION_NE - SNAP_POSITION_E),
-  EDGE_GRAVITY_CENTER = (SNAP_POSITION_EC - SNAP_POSITION_E),
-  EDGE_GRAVITY_END = (SNAP_POSITION_SE - SNAP_POSITION_E)
-};
-
 enum _StrutsEdge
 {
   STRUTS_EDGE_NONE = 0,
@@ -375,12 +341,21 @@ struct _PanelWindow
   /* struts information */
   StrutsEdge struts_edge;
   gulong struts[N_STRUTS];
+  guint struts_tick_id;
+#ifdef HAVE_GTK_LAYER_SHELL
+  gint exclusive_zone;
+#endif
   guint struts_enabled : 1;
   guint keep_below : 1;
 
   /* dark mode */
   gboolean dark_mode;
 
+  /* plugin properties waiting to be sent in a single pass */
+  PluginProp plugins_update_props;
+  PluginProp plugins_update_current;
+  guint plugins_update_id;
+
   /* window positioning */
   guint size;
   guint icon_size;
@@ -404,6 +379,13 @@ struct _PanelWindow
   /* allocated position of the panel */
   GdkRectangle alloc;
 
+  /* background, borders and handles rendered for this size */
+  cairo_surface_t *chrome;
+  gint chrome_width;
+  gint chrome_height;
+  gint chrome_scale;
+  gboolean chrome_locked;
+
   /* autohiding */
   XfwWindow *xfw_active_window;
   GtkWidget *autohide_window;
@@ -415,7 +397,13 @@ struct _PanelWindow
   gint autohide_block;
   guint autohide_size;
   guint popdown_speed;
-  gint popdown_progress;
+  gdouble popdown_progress;
+  gint64 popdown_start_time;
+  gint popdown_start_x;
+  gint popdown_start_y;
+  gboolean popdown_in_place;
+  gint popdown_offset_x;
+  gint popdown_offset_y;
 
   /* popup/down delay from gtk style */
   guint popup_delay;
@@ -450,6 +438,35 @@ typedef PanelWindowClass XfcePanelWindowClass;
 static GdkAtom cardinal_atom = 0;
 static GdkAtom net_wm_strut_partial_atom = 0;
 
+/* monitor layout shared by all panels, dropped when the monitors change,
+ * and the panels waiting for a new layout */
+static PanelLayoutSnapshot *layout_snapshot = NULL;
+static GSList *layout_windows = NULL;
+static guint layout_idle_id = 0;
+
+/* panels waiting for an intellihide overlap check */
+static GSList *intellihide_windows = NULL;
+static guint intellihide_idle_id = 0;
+
+#ifdef ENABLE_X11
+/* frame extents of the active windows, attached to the XfwWindow and
+ * indexed by xid for the PropertyNotify filter */
+typedef struct _FrameExtents
+{
+  Window xid;
+  GtkBorder gtk;
+  GtkBorder net;
+  guint gtk_valid : 1;
+  guint has_gtk : 1;
+  guint net_valid : 1;
+  guint has_net : 1;
+} FrameExtents;
+
+static GHashTable *frame_extents_cache = NULL;
+static Atom gtk_frame_extents_atom = None;
+static Atom net_frame_extents_atom = None;
+#endif
+
 
 
 G_DEFINE_FINAL_TYPE (XfcePanelWindow, panel_window, PANEL_TYPE_BASE_WINDOW)
@@ -723,6 +740,13 @@ panel_window_init (PanelWindow *window)
   window->xfw_active_window = NULL;
   window->struts_edge = STRUTS_EDGE_NONE;
   window->struts_enabled = TRUE;
+  window->struts_tick_id = 0;
+#ifdef HAVE_GTK_LAYER_SHELL
+  window->exclusive_zone = -1;
+#endif
+  window->plugins_update_props = 0;
+  window->plugins_update_current = 0;
+  window->plugins_update_id = 0;
   window->keep_below = FALSE;
   window->mode = XFCE_PANEL_PLUGIN_MODE_HORIZONTAL;
   window->size = 48;
@@ -746,13 +770,21 @@ panel_window_init (PanelWindow *window)
   window->popup_delay = DEFAULT_POPUP_DELAY;
   window->popdown_delay = DEFAULT_POPDOWN_DELAY;
   window->popdown_speed = DEFAULT_POPDOWN_SPEED;
-  window->popdown_progress = -G_MAXINT;
+  window->popdown_progress = -1.0;
+  window->popdown_start_time = 0;
+  window->popdown_in_place = FALSE;
+  window->popdown_offset_x = 0;
+  window->popdown_offset_y = 0;
   window->base_x = -1;
   window->base_y = -1;
   window->grab_time = 0;
   window->grab_x = 0;
   window->grab_y = 0;
   window->wl_active_is_maximized = FALSE;
+  window->chrome = NULL;
+
+  /* the background is drawn from a cached surface in panel_window_draw() */
+  gtk_widget_set_app_paintable (GTK_WIDGET (window), TRUE);
 
   /* not resizable, so allocation will follow size request */
   gtk_window_set_resizable (GTK_WINDOW (window), FALSE);
@@ -909,8 +941,7 @@ panel_window_set_property (GObject *object,
         }
       panel_base_window_orientation_changed (PANEL_BASE_WINDOW (window), window->mode);
       /* send the new orientation and screen position to the panel plugins */
-      panel_window_plugins_update (window, PLUGIN_PROP_MODE);
-      panel_window_plugins_update (window, PLUGIN_PROP_SCREEN_POSITION);
+      panel_window_plugins_queue_update (window, PLUGIN_PROP_MODE | PLUGIN_PROP_SCREEN_POSITION);
       break;
 
     case PROP_SIZE:
@@ -922,14 +953,14 @@ panel_window_set_property (GObject *object,
         }
 
       /* send the new size to the panel plugins */
-      panel_window_plugins_update (window, PLUGIN_PROP_SIZE);
+      panel_window_plugins_queue_update (window, PLUGIN_PROP_SIZE);
       break;
 
     case PROP_ICON_SIZE:
       window->icon_size = g_value_get_uint (value);
 
       /* send the new icon size to the panel plugins */
-      panel_window_plugins_update (window, PLUGIN_PROP_ICON_SIZE);
+      panel_window_plugins_queue_update (window, PLUGIN_PROP_ICON_SIZE);
       break;
 
     case PROP_DARK_MODE:
@@ -940,7 +971,7 @@ panel_window_set_property (GObject *object,
                     "gtk-application-prefer-dark-theme",
                     window->dark_mode,
                     NULL);
-      panel_window_plugins_update (window, PLUGIN_PROP_DARK_MODE);
+      panel_window_plugins_queue_update (window, PLUGIN_PROP_DARK_MODE);
       break;
 
     case PROP_NROWS:
@@ -952,7 +983,7 @@ panel_window_set_property (GObject *object,
         }
 
       /* send the new size to the panel plugins */
-      panel_window_plugins_update (window, PLUGIN_PROP_NROWS);
+      panel_window_plugins_queue_update (window, PLUGIN_PROP_NROWS);
       break;
 
     case PROP_LENGTH:
@@ -1042,7 +1073,7 @@ panel_window_set_property (GObject *object,
           panel_window_screen_layout_changed (window->xfw_screen, window);
 
           /* send the new screen position to the panel plugins */
-          panel_window_plugins_update (window, PLUGIN_PROP_SCREEN_POSITION);
+          panel_window_plugins_queue_update (window, PLUGIN_PROP_SCREEN_POSITION);
         }
       break;
 
@@ -1099,16 +1130,25 @@ panel_window_finalize (GObject *object)
   /* disconnect from active screen */
   panel_window_update_xfw_screen (window, NULL);
 
+  intellihide_windows = g_slist_remove (intellihide_windows, window);
+  layout_windows = g_slist_remove (layout_windows, window);
+
   /* stop running autohide timeout */
   if (G_UNLIKELY (window->autohide_timeout_id != 0))
     g_source_remove (window->autohide_timeout_id);
 
   if (G_UNLIKELY (window->autohide_ease_out_id != 0))
-    g_source_remove (window->autohide_ease_out_id);
+    gtk_widget_remove_tick_callback (GTK_WIDGET (window), window->autohide_ease_out_id);
 
   if (G_UNLIKELY (window->opacity_timeout_id != 0))
     g_source_remove (window->opacity_timeout_id);
 
+  if (G_UNLIKELY (window->struts_tick_id != 0))
+    gtk_widget_remove_tick_callback (GTK_WIDGET (window), window->struts_tick_id);
+
+  if (G_UNLIKELY (window->plugins_update_id != 0))
+    g_source_remove (window->plugins_update_id);
+
 #ifdef HAVE_GTK_LAYER_SHELL
   if (G_UNLIKELY (window->show_id != 0))
     g_source_remove (window->show_id);
@@ -1122,16 +1162,19 @@ panel_window_finalize (GObject *object)
 
   g_free (window->output_name);
 
+  if (window->chrome != NULL)
+    cairo_surface_destroy (window->chrome);
+
   (*G_OBJECT_CLASS (panel_window_parent_class)->finalize) (object);
 }
 
 
 
-static gboolean
-panel_window_draw (GtkWidget *widget,
-                   cairo_t *cr)
+static void
+panel_window_chrome_render (PanelWindow *window,
+                            cairo_t *cr)
 {
-  PanelWindow *window = PANEL_WINDOW (widget);
+  GtkWidget *widget = GTK_WIDGET (window);
   GdkRGBA fg_rgba;
   GdkRGBA *dark_rgba;
   guint xx, yy, i;
@@ -1139,11 +1182,13 @@ panel_window_draw (GtkWidget *widget,
   gint handle_w, handle_h;
   GtkStyleContext *ctx;
 
-  /* expose the background and borders handled in PanelBaseWindow */
-  (*GTK_WIDGET_CLASS (panel_window_parent_class)->draw) (widget, cr);
+  /* the css background and borders, gtk would otherwise draw them in every frame */
+  ctx = gtk_widget_get_style_context (widget);
+  gtk_render_background (ctx, cr, 0, 0, window->alloc.width, window->alloc.height);
+  gtk_render_frame (ctx, cr, 0, 0, window->alloc.width, window->alloc.height);
 
-  if (window->position_locked || !gtk_widget_is_drawable (widget))
-    return FALSE;
+  if (window->position_locked)
+    return;
 
   if (IS_HORIZONTAL (window))
     {
@@ -1164,11 +1209,10 @@ panel_window_draw (GtkWidget *widget,
       ye = window->alloc.height - HANDLE_SIZE - HANDLE_SIZE;
     }
 
-  /* create cairo context and set some default properties */
+  /* set some default properties */
   cairo_set_antialias (cr, CAIRO_ANTIALIAS_NONE);
   cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
 
-  ctx = gtk_widget_get_style_context (widget);
   gtk_style_context_get_color (ctx, gtk_widget_get_state_flags (widget), &fg_rgba);
   dark_rgba = gdk_rgba_copy (&fg_rgba);
   fg_rgba.alpha = 0.5;
@@ -1194,8 +1238,80 @@ panel_window_draw (GtkWidget *widget,
       cairo_fill (cr);
     }
   gdk_rgba_free (dark_rgba);
+}
 
-  return FALSE;
+
+
+static gboolean
+panel_window_draw (GtkWidget *widget,
+                   cairo_t *cr)
+{
+  PanelWindow *window = PANEL_WINDOW (widget);
+  cairo_t *chrome_cr;
+  gint scale_factor;
+
+  if (!gtk_widget_is_drawable (widget))
+    return FALSE;
+
+  /* re-render the chrome only when its size, scale, style or lock state changed */
+  scale_factor = gtk_widget_get_scale_factor (widget);
+  if (window->chrome == NULL
+      || window->chrome_width != window->alloc.width
+      || window->chrome_height != window->alloc.height
+      || window->chrome_scale != scale_factor
+      || window->chrome_locked != window->position_locked)
+    {
+      if (window->chrome != NULL)
+        cairo_surface_destroy (window->chrome);
+
+      window->chrome = gdk_window_create_similar_surface (gtk_widget_get_window (widget),
+                                                          CAIRO_CONTENT_COLOR_ALPHA,
+                                                          window->alloc.width,
+                                                          window->alloc.height);
+      window->chrome_width = window->alloc.width;
+      window->chrome_height = window->alloc.height;
+      window->chrome_scale = scale_factor;
+      window->chrome_locked = window->position_locked;
+
+      chrome_cr = cairo_create (window->chrome);
+      panel_window_chrome_render (window, chrome_cr);
+      cairo_destroy (chrome_cr);
+    }
+
+  /* the panel is sliding out in place, clear the part of the window it
+   * left and draw everything else at the slide offset */
+  if (window->popdown_offset_x != 0 || window->popdown_offset_y != 0)
+    {
+      cairo_save (cr);
+      cairo_set_operator (cr, CAIRO_OPERATOR_CLEAR);
+      cairo_paint (cr);
+      cairo_restore (cr);
+      cairo_translate (cr, window->popdown_offset_x, window->popdown_offset_y);
+    }
+
+  /* copy the chrome, cairo is clipped to the damaged area already */
+  cairo_save (cr);
+  cairo_set_source_surface (cr, window->chrome, 0, 0);
+  cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+  cairo_paint (cr);
+  cairo_restore (cr);
+
+  /* the window is app-paintable, so this only draws the plugins */
+  return (*GTK_WIDGET_CLASS (panel_window_parent_class)->draw) (widget, cr);
+}
+
+
+
+static void
+panel_window_chrome_invalidate (PanelWindow *window)
+{
+  if (window->chrome != NULL)
+    {
+      cairo_surface_destroy (window->chrome);
+      window->chrome = NULL;
+    }
+
+  gtk_widget_queue_draw (GTK_WIDGET (window));
 }
 
 
@@ -1274,7 +1390,7 @@ panel_window_drag_leave (GtkWidget *widget,
     {
       /* simulate a geometry change to check for overlapping windows with intelligent hiding */
       if (window->autohide_behavior == AUTOHIDE_BEHAVIOR_INTELLIGENTLY)
-        panel_window_active_window_geometry_changed (window->xfw_active_window, window);
+        panel_window_active_window_geometry_changed (window);
       /* otherwise just hide the panel */
       else
         panel_window_autohide_queue (window, AUTOHIDE_POPDOWN_SLOW);
@@ -1369,7 +1485,8 @@ panel_window_motion_notify_event (GtkWidget *widget,
   window->alloc.y = window_y;
 
   /* update the snapping position */
-  snap_position = panel_window_snap_position (window);
+  snap_position = panel_layout_snap_position (&window->alloc, &window->area,
+                                              panel_base_window_get_borders (PANEL_BASE_WINDOW (window)));
   if (snap_position != window->snap_position)
     {
       window->snap_position = snap_position;
@@ -1481,8 +1598,13 @@ panel_window_button_release_event (GtkWidget *widget,
       /* store the new position */
       g_object_notify (G_OBJECT (widget), "position");
 
+      /* struts were held back during the drag */
+      if (window->struts_edge != STRUTS_EDGE_NONE
+          && window->autohide_behavior == AUTOHIDE_BEHAVIOR_NEVER)
+        panel_window_screen_struts_queue (window);
+
       /* send the new screen position to the panel plugins */
-      panel_window_plugins_update (window, PLUGIN_PROP_SCREEN_POSITION);
+      panel_window_plugins_queue_update (window, PLUGIN_PROP_SCREEN_POSITION);
 
       /* release autohide lock */
       panel_window_thaw_autohide (window);
@@ -1702,6 +1824,9 @@ panel_window_size_allocate (GtkWidget *widget,
   gint w, h, x, y;
   PanelBorders borders;
   GtkWidget *child;
+  gint64 trace_begin;
+
+  trace_begin = panel_trace_begin ();
 
   gtk_widget_set_allocation (widget, alloc);
   window->alloc = *alloc;
@@ -1710,7 +1835,7 @@ panel_window_size_allocate (GtkWidget *widget,
                   && (window->autohide_state == AUTOHIDE_HIDDEN
                       || window->autohide_state == AUTOHIDE_POPUP)))
     {
-      gboolean autohide_running = window->autohide_timeout_id != 0 || window->popdown_progress != -G_MAXINT;
+      gboolean autohide_running = window->autohide_timeout_id != 0 || window->popdown_progress >= 0.0;
 
       /* autohide timeout is already running, so let's wait with hiding the panel */
       if (autohide_running
@@ -1769,14 +1894,14 @@ panel_window_size_allocate (GtkWidget *widget,
           && (((y + h) == panel_screen_get_height (window->screen))
               || (y == 0)))
         {
-          window->popdown_progress = window->alloc.height;
+          window->popdown_progress = 0.0;
           window->floating = FALSE;
         }
       else if (!IS_HORIZONTAL (window)
                && (((x + w) == panel_screen_get_width (window->screen))
                    || (x == 0)))
         {
-          window->popdown_progress = window->alloc.width;
+          window->popdown_progress = 0.0;
           window->floating = FALSE;
         }
       else
@@ -1788,7 +1913,7 @@ panel_window_size_allocate (GtkWidget *widget,
         {
           /* cancel any pending animations */
           if (window->autohide_ease_out_id != 0)
-            g_source_remove (window->autohide_ease_out_id);
+            gtk_widget_remove_tick_callback (widget, window->autohide_ease_out_id);
 
           panel_window_move (window, GTK_WINDOW (window), window->alloc.x, window->alloc.y);
         }
@@ -1797,7 +1922,7 @@ panel_window_size_allocate (GtkWidget *widget,
     {
       /* stop a running autohide animation */
       if (window->autohide_ease_out_id != 0)
-        g_source_remove (window->autohide_ease_out_id);
+        gtk_widget_remove_tick_callback (widget, window->autohide_ease_out_id);
 
       /* update the allocation */
       panel_window_size_allocate_set_xy (window, alloc->width, alloc->height,
@@ -1806,7 +1931,7 @@ panel_window_size_allocate (GtkWidget *widget,
       /* update the struts if needed, leave when nothing changed */
       if (window->struts_edge != STRUTS_EDGE_NONE
           && window->autohide_behavior == AUTOHIDE_BEHAVIOR_NEVER)
-        panel_window_screen_struts_set (window);
+        panel_window_screen_struts_queue (window);
 
       if (window->autohide_window != NULL)
         gtk_widget_hide (window->autohide_window);
@@ -1858,6 +1983,8 @@ panel_window_size_allocate (GtkWidget *widget,
       gtk_widget_size_allocate (child, &child_alloc);
       gtk_widget_set_clip (child, alloc);
     }
+
+  panel_trace_end (trace_begin, "window", "size-allocate", NULL, window->id);
 }
 
 
@@ -2076,6 +2203,9 @@ panel_window_style_updated (GtkWidget *widget)
   /* Make sure the background and borders are redrawn on Gtk theme changes */
   if (panel_base_window_get_background_style (base_window) == PANEL_BG_STYLE_NONE)
     panel_base_window_reset_background_css (base_window);
+
+  /* css backgrounds, borders and the handle color may have changed */
+  panel_window_chrome_invalidate (window);
 }
 
 
@@ -2276,6 +2406,51 @@ panel_window_screen_struts_edge (PanelWindow *window)
 
 
 
+static gboolean
+panel_window_screen_struts_tick (GtkWidget *widget,
+                                 GdkFrameClock *frame_clock,
+                                 gpointer user_data)
+{
+  PanelWindow *window = PANEL_WINDOW (widget);
+
+  /* do not publish transient struts while the panel is moving */
+  if (window->grab_time != 0 || window->autohide_ease_out_id != 0)
+    return G_SOURCE_CONTINUE;
+
+  window->struts_tick_id = 0;
+  panel_window_screen_struts_set (window);
+
+  return G_SOURCE_REMOVE;
+}
+
+
+
+static void
+panel_window_screen_struts_queue (PanelWindow *window)
+{
+  GtkWidget *widget = GTK_WIDGET (window);
+
+  panel_return_if_fail (PANEL_IS_WINDOW (window));
+
+  if (!gtk_widget_get_realized (widget))
+    return;
+
+  /* nothing is drawn yet, so there is no frame to wait for */
+  if (!gtk_widget_get_mapped (widget))
+    {
+      panel_window_screen_struts_set (window);
+      return;
+    }
+
+  /* publish the struts once per frame, each update makes the window
+   * manager re-layout all maximized windows */
+  if (window->struts_tick_id == 0)
+    window->struts_tick_id = gtk_widget_add_tick_callback (widget, panel_window_screen_struts_tick,
+                                                           NULL, NULL);
+}
+
+
+
 static void
 panel_window_screen_struts_set (PanelWindow *window)
 {
@@ -2302,19 +2477,27 @@ panel_window_screen_struts_set (PanelWindow *window)
         {
         case STRUTS_EDGE_TOP:
         case STRUTS_EDGE_BOTTOM:
-          gtk_layer_set_exclusive_zone (GTK_WINDOW (window), window->alloc.height);
+          n = window->alloc.height;
           break;
 
         case STRUTS_EDGE_LEFT:
         case STRUTS_EDGE_RIGHT:
-          gtk_layer_set_exclusive_zone (GTK_WINDOW (window), window->alloc.width);
+          n = window->alloc.width;
           break;
 
         default:
-          gtk_layer_set_exclusive_zone (GTK_WINDOW (window), -1);
+          n = -1;
           break;
         }
 
+      /* every change makes the compositor rearrange the other surfaces */
+      if (n != window->exclusive_zone)
+        {
+          window->exclusive_zone = n;
+          gtk_layer_set_exclusive_zone (GTK_WINDOW (window), n);
+          panel_debug (PANEL_DEBUG_STRUTS, "%p: exclusive zone=%d", window, n);
+        }
+
       return;
     }
 #endif
@@ -2488,81 +2671,6 @@ panel_window_screen_update_borders (PanelWindow *window)
 
 
 
-static inline guint
-panel_window_snap_edge_gravity (gint value,
-                                gint start,
-                                gint end)
-{
-  gint center;
-
-  /* snap at the start */
-  if (value >= start && value <= start + SNAP_DISTANCE)
-    return EDGE_GRAVITY_START;
-
-  /* snap at the end */
-  if (value <= end && value >= end - SNAP_DISTANCE)
-    return EDGE_GRAVITY_END;
-
-  /* snap at the center */
-  center = start + (end - start) / 2;
-  if (value >= center - 10 && value <= center + SNAP_DISTANCE)
-    return EDGE_GRAVITY_CENTER;
-
-  return EDGE_GRAVITY_NONE;
-}
-
-
-
-static SnapPosition
-panel_window_snap_position (PanelWindow *window)
-{
-  guint snap_horz, snap_vert;
-  GdkRectangle alloc = window->alloc;
-  PanelBorders borders;
-
-  /* make the same calculation whether the panel is snapped or not (avoids flickering
-   * when the pointer moves slowly) */
-  borders = panel_base_window_get_borders (PANEL_BASE_WINDOW (window));
-  if (!PANEL_HAS_FLAG (borders, PANEL_BORDER_TOP) && PANEL_HAS_FLAG (borders, PANEL_BORDER_BOTTOM))
-    alloc.height++;
-  else if (PANEL_HAS_FLAG (borders, PANEL_BORDER_TOP) && !PANEL_HAS_FLAG (borders, PANEL_BORDER_BOTTOM))
-    {
-      alloc.y--;
-      alloc.height++;
-    }
-  if (!PANEL_HAS_FLAG (borders, PANEL_BORDER_LEFT) && PANEL_HAS_FLAG (borders, PANEL_BORDER_RIGHT))
-    alloc.width++;
-  else if (PANEL_HAS_FLAG (borders, PANEL_BORDER_LEFT) && !PANEL_HAS_FLAG (borders, PANEL_BORDER_RIGHT))
-    {
-      alloc.x--;
-      alloc.width++;
-    }
-
-  /* get the snap offsets */
-  snap_horz = panel_window_snap_edge_gravity (alloc.x, window->area.x,
-                                              window->area.x + window->area.width - alloc.width);
-  snap_vert = panel_window_snap_edge_gravity (alloc.y, window->area.y,
-                                              window->area.y + window->area.height - alloc.height);
-
-  /* detect the snap mode */
-  if (snap_horz == EDGE_GRAVITY_START)
-    return SNAP_POSITION_W + snap_vert;
-  else if (snap_horz == EDGE_GRAVITY_END)
-    return SNAP_POSITION_E + snap_vert;
-  else if (snap_horz == EDGE_GRAVITY_CENTER && snap_vert == EDGE_GRAVITY_START)
-    return SNAP_POSITION_NC;
-  else if (snap_horz == EDGE_GRAVITY_CENTER && snap_vert == EDGE_GRAVITY_END)
-    return SNAP_POSITION_SC;
-  else if (snap_horz == EDGE_GRAVITY_NONE && snap_vert == EDGE_GRAVITY_START)
-    return SNAP_POSITION_N;
-  else if (snap_horz == EDGE_GRAVITY_NONE && snap_vert == EDGE_GRAVITY_END)
-    return SNAP_POSITION_S;
-
-  return SNAP_POSITION_NONE;
-}
-
-
-
 static void
 panel_window_layer_set_anchor (PanelWindow *window)
 {
@@ -2786,16 +2894,52 @@ panel_window_show (gpointer data)
 
 
 
+static PanelLayoutSnapshot *
+panel_window_layout_snapshot (PanelWindow *window)
+{
+  XfwMonitor *primary;
+  GdkRectangle geometry;
+
+  /* all panels are on the default screen, so they share the snapshot */
+  if (layout_snapshot == NULL)
+    {
+      layout_snapshot = panel_layout_snapshot_new ();
+      primary = xfw_screen_get_primary_monitor (window->xfw_screen);
+      for (GList *lp = xfw_screen_get_monitors (window->xfw_screen); lp != NULL; lp = lp->next)
+        {
+          xfw_monitor_get_logical_geometry (lp->data, &geometry);
+          panel_layout_snapshot_add_monitor (layout_snapshot, &geometry,
+                                             xfw_monitor_get_connector (lp->data),
+                                             lp->data == primary);
+        }
+    }
+
+  return layout_snapshot;
+}
+
+
+
 static void
-panel_window_screen_layout_changed (XfwScreen *screen,
-                                    PanelWindow *window)
+panel_window_layout_panel (PanelWindow *window,
+                           PanelLayoutPanel *panel)
+{
+  panel->output_name = window->output_name;
+  panel->span_monitors = window->span_monitors;
+  panel->base_x = window->base_x;
+  panel->base_y = window->base_y;
+}
+
+
+
+static void
+panel_window_screen_layout_commit (PanelWindow *window,
+                                   PanelLayoutSnapshot *snapshot,
+                                   const PanelLayoutResult *result)
 {
-  GdkRectangle a = { 0 };
+  GdkRectangle a = result->area;
   XfwMonitor *monitor = NULL;
 
   panel_return_if_fail (PANEL_IS_WINDOW (window));
-  panel_return_if_fail (XFW_IS_SCREEN (screen));
-  panel_return_if_fail (window->xfw_screen == screen);
 
   /* leave when the screen position if not set */
   if (window->base_x == -1 && window->base_y == -1)
@@ -2813,9 +2957,8 @@ panel_window_screen_layout_changed (XfwScreen *screen,
     }
 #endif
 
-  /* monitors == NULL should be a temporary state, it can happen on Wayland */
-  GList *monitors = xfw_screen_get_monitors (window->xfw_screen);
-  if (monitors == NULL)
+  /* no monitors should be a temporary state, it can happen on Wayland */
+  if (panel_layout_snapshot_get_n_monitors (snapshot) == 0)
     {
       panel_debug (PANEL_DEBUG_POSITIONING, "%p: no monitor found, hiding window", window);
 
@@ -2843,105 +2986,18 @@ panel_window_screen_layout_changed (XfwScreen *screen,
   window->struts_edge = struts_edge;
 
   panel_debug (PANEL_DEBUG_POSITIONING,
-               "%p: screen=%p, monitors=%d, output-name=%s, span-monitors=%s, base=%d,%d",
-               window, screen,
-               g_list_length (monitors), window->output_name,
+               "%p: screen=%p, monitors=%u, output-name=%s, span-monitors=%s, base=%d,%d",
+               window, window->xfw_screen,
+               panel_layout_snapshot_get_n_monitors (snapshot), window->output_name,
                PANEL_DEBUG_BOOL (window->span_monitors),
                window->base_x, window->base_y);
 
-  if ((window->output_name == NULL || g_strcmp0 (window->output_name, "Automatic") == 0)
-      && (window->span_monitors || g_list_length (monitors) == 1))
-    {
-      /* get the screen geometry we also use this if there is only
-       * one monitor and no output is choosen, as a fast-path */
-      monitor = monitors->data;
-      xfw_monitor_get_logical_geometry (monitor, &a);
-
-      a.width += a.x;
-      a.height += a.y;
-
-      for (GList *lp = monitors->next; lp != NULL; lp = lp->next)
-        {
-          GdkRectangle b;
-          xfw_monitor_get_logical_geometry (lp->data, &b);
-
-          a.x = MIN (a.x, b.x);
-          a.y = MIN (a.y, b.y);
-          a.width = MAX (a.width, b.x + b.width);
-          a.height = MAX (a.height, b.y + b.height);
-        }
-
-      a.width -= a.x;
-      a.height -= a.y;
-    }
-  else
-    {
-      if (g_strcmp0 (window->output_name, "Automatic") == 0
-          || window->output_name == NULL)
-        {
-          /* get the monitor geometry based on the panel position */
-          GdkMonitor *gdk_monitor = gdk_display_get_monitor_at_point (window->display, window->base_x, window->base_y);
-          monitor = xfw_screen_get_monitor_from_gdk_monitor (window->xfw_screen, gdk_monitor);
-          xfw_monitor_get_logical_geometry (monitor, &a);
-        }
-      else if (g_strcmp0 (window->output_name, "Primary") == 0)
-        {
-          /* get the primary monitor */
-          monitor = xfw_screen_get_primary_monitor (window->xfw_screen);
-          if (monitor == NULL)
-            monitor = monitors->data;
-
-          xfw_monitor_get_logical_geometry (monitor, &a);
-        }
-      else
-        {
-          /* check if we've stored the monitor number in the config or
-           * should lookup the number from the randr output name */
-          gint n;
-          if (strncmp (window->output_name, "monitor-", 8) == 0
-              && sscanf (window->output_name, "monitor-%d", &n) == 1)
-            {
-              /* check if extracted monitor number is out of range */
-              monitor = g_list_nth_data (monitors, n);
-              if (monitor != NULL)
-                {
-                  const gchar *name = xfw_monitor_get_connector (monitor);
-                  gboolean matches = xfce_str_is_empty (name);
-                  if (!matches)
-                    {
-                      gchar *p = g_strstr_len (window->output_name + 8, -1, "-");
-                      if (p != NULL && g_strcmp0 (p + 1, name) == 0)
-                        matches = TRUE;
-                    }
-
-                  if (matches)
-                    {
-                      xfw_monitor_get_logical_geometry (monitor, &a);
-                    }
-                }
-            }
-          else
-            {
-              /* detect the monitor number by output name */
-              for (GList *lp = monitors; lp != NULL; lp = lp->next)
-                {
-                  monitor = lp->data;
-                  const gchar *name = xfw_monitor_get_connector (monitor);
-
-                  /* check if this is the monitor we're looking for */
-                  if (g_strcmp0 (window->output_name, name) == 0)
-                    {
-                      xfw_monitor_get_logical_geometry (monitor, &a);
-                      panel_return_if_fail (a.width > 0 && a.height > 0);
-                      break;
-                    }
-                }
-            }
-        }
-    }
+  /* the snapshot is taken from the current monitors of the screen */
+  if (result->monitor != -1)
+    monitor = g_list_nth_data (xfw_screen_get_monitors (window->xfw_screen), result->monitor);
 
   /* monitor was not found or is an unusable fake monitor on wayland */
-  if (G_UNLIKELY (a.height == 0 || a.width == 0))
+  if (G_UNLIKELY (monitor == NULL || a.height == 0 || a.width == 0))
     {
       panel_debug (PANEL_DEBUG_POSITIONING,
                    "%p: monitor %s not found, hiding window",
@@ -2964,7 +3020,7 @@ panel_window_screen_layout_changed (XfwScreen *screen,
   window->area = a;
   panel_debug (PANEL_DEBUG_POSITIONING,
                "%p: working-area: screen=%p, x=%d, y=%d, w=%d, h=%d",
-               window, screen,
+               window, window->xfw_screen,
                a.x, a.y, a.width, a.height);
 
   /* update max length in pixels with notification */
@@ -2976,7 +3032,7 @@ panel_window_screen_layout_changed (XfwScreen *screen,
 
   /* update the struts if needed (ie. we need to reset the struts) */
   if (force_struts_update)
-    panel_window_screen_struts_set (window);
+    panel_window_screen_struts_queue (window);
 
 #ifdef HAVE_GTK_LAYER_SHELL
   if (gtk_layer_is_supported ())
@@ -3016,53 +3072,123 @@ panel_window_screen_layout_changed (XfwScreen *screen,
 
 
 
+static void
+panel_window_screen_layout_changed (XfwScreen *screen,
+                                    PanelWindow *window)
+{
+  PanelLayoutPanel panel;
+  PanelLayoutResult result;
+
+  panel_return_if_fail (PANEL_IS_WINDOW (window));
+  panel_return_if_fail (XFW_IS_SCREEN (screen));
+  panel_return_if_fail (window->xfw_screen == screen);
+
+  /* leave when the screen position if not set */
+  if (window->base_x == -1 && window->base_y == -1)
+    return;
+
+  panel_window_layout_panel (window, &panel);
+  panel_layout_solve (panel_window_layout_snapshot (window), &panel, &result, 1);
+  panel_window_screen_layout_commit (window, layout_snapshot, &result);
+}
+
+
+
+static gboolean
+panel_window_screen_layout_idle (gpointer data)
+{
+  PanelLayoutSnapshot *snapshot;
+  PanelLayoutPanel *panels;
+  PanelLayoutResult *results;
+  GSList *windows, *li;
+  guint n_windows, i;
+
+  layout_idle_id = 0;
+
+  windows = g_slist_reverse (layout_windows);
+  layout_windows = NULL;
+  if (windows == NULL)
+    return G_SOURCE_REMOVE;
+
+  /* solve all panels in one pass on the same snapshot */
+  n_windows = g_slist_length (windows);
+  panels = g_new (PanelLayoutPanel, n_windows);
+  results = g_new (PanelLayoutResult, n_windows);
+  for (li = windows, i = 0; li != NULL; li = li->next, i++)
+    panel_window_layout_panel (li->data, &panels[i]);
+
+  snapshot = panel_layout_snapshot_ref (panel_window_layout_snapshot (windows->data));
+  panel_layout_solve (snapshot, panels, results, n_windows);
+
+  /* and commit the results */
+  for (li = windows, i = 0; li != NULL; li = li->next, i++)
+    panel_window_screen_layout_commit (li->data, snapshot, &results[i]);
+
+  panel_layout_snapshot_unref (snapshot);
+  g_free (panels);
+  g_free (results);
+  g_slist_free (windows);
+
+  return G_SOURCE_REMOVE;
+}
+
+
+
+static void
+panel_window_screen_monitors_changed (XfwScreen *screen,
+                                      PanelWindow *window)
+{
+  panel_return_if_fail (PANEL_IS_WINDOW (window));
+  panel_return_if_fail (window->xfw_screen == screen);
+
+  /* monitor hotplug events come in bursts and are received by every panel,
+   * lay out all panels once the burst is over */
+  g_clear_pointer (&layout_snapshot, panel_layout_snapshot_unref);
+
+  if (g_slist_find (layout_windows, window) == NULL)
+    layout_windows = g_slist_prepend (layout_windows, window);
+
+  if (layout_idle_id == 0)
+    layout_idle_id = g_idle_add_full (G_PRIORITY_HIGH_IDLE, panel_window_screen_layout_idle, NULL, NULL);
+}
+
+
+
 static void
 panel_window_active_window_monitors_idle (gpointer data)
 {
   PanelWindow *window = data;
 
   if (window->xfw_active_window != NULL)
-    panel_window_active_window_monitors (window->xfw_active_window, NULL, window);
+    panel_window_active_window_state_changed (window, 0,
+                                              xfw_window_get_state (window->xfw_active_window),
+                                              xfw_window_get_monitors (window->xfw_active_window));
 }
 
 
 
-static void
-panel_window_update_active_window (PanelWindow *window,
-                                   XfwWindow *active_window)
+void
+panel_window_set_active_window (PanelWindow *window,
+                                XfwWindow *active_window)
 {
-  /* disconnect from previously active window */
-  if (G_LIKELY (window->xfw_active_window != NULL))
-    {
-      g_signal_handlers_disconnect_by_func (window->xfw_active_window,
-                                            panel_window_active_window_geometry_changed, window);
-      g_signal_handlers_disconnect_by_func (window->xfw_active_window,
-                                            panel_window_active_window_state_changed, window);
-      if (gtk_layer_is_supported ())
-        g_signal_handlers_disconnect_by_func (window->xfw_active_window,
-                                              panel_window_active_window_monitors, window);
-    }
+  panel_return_if_fail (PANEL_IS_WINDOW (window));
+  panel_return_if_fail (active_window == NULL || XFW_IS_WINDOW (active_window));
 
-  /* remember the new window */
+  /* remember the new window, signals of the active window are handled
+   * once for all panels by the application */
   window->xfw_active_window = active_window;
 
-  /* connect to the new window */
   if (active_window != NULL)
     {
-      g_signal_connect (G_OBJECT (active_window), "geometry-changed",
-                        G_CALLBACK (panel_window_active_window_geometry_changed), window);
-      g_signal_connect (G_OBJECT (active_window), "state-changed",
-                        G_CALLBACK (panel_window_active_window_state_changed), window);
       if (gtk_layer_is_supported ())
         {
-          g_signal_connect (G_OBJECT (active_window), "notify::monitors",
-                            G_CALLBACK (panel_window_active_window_monitors), window);
-
           /* wait for panel position to be initialized */
           if (window->base_x == -1 && window->base_y == -1)
             g_idle_add_once (panel_window_active_window_monitors_idle, window);
           else
-            panel_window_active_window_monitors (window->xfw_active_window, NULL, window);
+            panel_window_active_window_state_changed (window, 0,
+                                                      xfw_window_get_state (active_window),
+                                                      xfw_window_get_monitors (active_window));
 
           /* stay connected even if the window is not active anymore, because
            * closing it can impact intellihide on Wayland */
@@ -3074,31 +3200,12 @@ panel_window_update_active_window (PanelWindow *window,
       else
         /* simulate a geometry change for immediate hiding when the new active
          * window already overlaps the panel */
-        panel_window_active_window_geometry_changed (active_window, window);
+        panel_window_active_window_geometry_changed (window);
     }
 }
 
 
 
-static void
-panel_window_active_window_changed (XfwScreen *screen,
-                                    XfwWindow *previous_window,
-                                    PanelWindow *window)
-{
-  XfwWindow *active_window;
-
-  panel_return_if_fail (XFW_IS_SCREEN (screen));
-  panel_return_if_fail (PANEL_IS_WINDOW (window));
-
-  /* obtain new active window from the screen */
-  active_window = xfw_screen_get_active_window (screen);
-
-  /* update the active window to be used for the autohide feature */
-  panel_window_update_active_window (window, active_window);
-}
-
-
-
 gboolean
 panel_window_pointer_is_outside (PanelWindow *window)
 {
@@ -3150,20 +3257,279 @@ panel_window_pointer_is_outside (PanelWindow *window)
 
 
 
+#ifdef ENABLE_X11
+static GdkFilterReturn
+panel_window_frame_extents_filter (GdkXEvent *xev,
+                                   GdkEvent *gev,
+                                   gpointer data)
+{
+  XEvent *xevent = (XEvent *) xev;
+  FrameExtents *extents;
+
+  if (xevent->type != PropertyNotify)
+    return GDK_FILTER_CONTINUE;
+
+  if (xevent->xproperty.atom != gtk_frame_extents_atom
+      && xevent->xproperty.atom != net_frame_extents_atom)
+    return GDK_FILTER_CONTINUE;
+
+  /* read the property again on the next geometry change */
+  extents = g_hash_table_lookup (frame_extents_cache, GSIZE_TO_POINTER (xevent->xproperty.window));
+  if (extents != NULL)
+    {
+      if (xevent->xproperty.atom == gtk_frame_extents_atom)
+        extents->gtk_valid = FALSE;
+      else
+        extents->net_valid = FALSE;
+    }
+
+  return GDK_FILTER_CONTINUE;
+}
+
+
+
+static void
+panel_window_frame_extents_free (gpointer data)
+{
+  FrameExtents *extents = data;
+
+  g_hash_table_remove (frame_extents_cache, GSIZE_TO_POINTER (extents->xid));
+  g_slice_free (FrameExtents, extents);
+}
+
+
+
+static gboolean
+panel_window_frame_extents_read (Window xid,
+                                 Atom atom,
+                                 GtkBorder *border)
+{
+  GdkDisplay *display = gdk_display_get_default ();
+  Atom real_type;
+  int real_format;
+  unsigned long items_read, items_left;
+  unsigned long *data = NULL;
+  gboolean result = FALSE;
+
+  gdk_x11_display_error_trap_push (display);
+
+  if (XGetWindowProperty (GDK_DISPLAY_XDISPLAY (display), xid, atom,
+                          0, 4, FALSE, XA_CARDINAL,
+                          &real_type, &real_format, &items_read, &items_left,
+                          (unsigned char **) &data)
+        == Success
+      && real_type == XA_CARDINAL && real_format == 32 && items_read >= 4)
+    {
+      border->left = data[0];
+      border->right = data[1];
+      border->top = data[2];
+      border->bottom = data[3];
+      result = TRUE;
+    }
+
+  if (data != NULL)
+    XFree (data);
+
+  gdk_x11_display_error_trap_pop_ignored (display);
+
+  return result;
+}
+
+
+
+static FrameExtents *
+panel_window_frame_extents_get (XfwWindow *xfw_window)
+{
+  FrameExtents *extents;
+  GdkDisplay *display;
+  GdkWindow *gdkwindow;
+
+  extents = g_object_get_data (G_OBJECT (xfw_window), "panel-frame-extents");
+  if (G_LIKELY (extents != NULL))
+    return extents;
+
+  display = gdk_display_get_default ();
+  if (G_UNLIKELY (frame_extents_cache == NULL))
+    {
+      gtk_frame_extents_atom = gdk_x11_get_xatom_by_name_for_display (display, "_GTK_FRAME_EXTENTS");
+      net_frame_extents_atom = gdk_x11_get_xatom_by_name_for_display (display, "_NET_FRAME_EXTENTS");
+      frame_extents_cache = g_hash_table_new (g_direct_hash, g_direct_equal);
+      gdk_window_add_filter (NULL, panel_window_frame_extents_filter, NULL);
+    }
+
+  extents = g_slice_new0 (FrameExtents);
+  extents->xid = xfw_window_x11_get_xid (xfw_window);
+
+  /* make sure property changes are reported, usually libwnck did this already */
+  gdkwindow = gdk_x11_window_foreign_new_for_display (display, extents->xid);
+  if (gdkwindow != NULL)
+    {
+      gdk_window_set_events (gdkwindow, gdk_window_get_events (gdkwindow) | GDK_PROPERTY_CHANGE_MASK);
+      g_object_unref (gdkwindow);
+    }
+
+  g_hash_table_insert (frame_extents_cache, GSIZE_TO_POINTER (extents->xid), extents);
+  g_object_set_data_full (G_OBJECT (xfw_window), "panel-frame-extents",
+                          extents, panel_window_frame_extents_free);
+
+  return extents;
+}
+#endif
+
+
+
 static void
-panel_window_active_window_geometry_changed (XfwWindow *active_window,
-                                             PanelWindow *window)
+panel_window_active_window_get_area (XfwWindow *active_window,
+                                     GdkRectangle *window_area)
+{
+#ifdef ENABLE_X11
+  FrameExtents *extents;
+#endif
+
+  /* obtain position and dimensions from the active window */
+  *window_area = *(xfw_window_get_geometry (active_window));
+
+#ifdef ENABLE_X11
+  extents = panel_window_frame_extents_get (active_window);
+
+  /* if a window uses client-side decorations, check the _GTK_FRAME_EXTENTS
+   * application window property to get its actual size without the shadows */
+  if (!extents->gtk_valid)
+    {
+      extents->has_gtk = panel_window_frame_extents_read (extents->xid, gtk_frame_extents_atom, &extents->gtk);
+      extents->gtk_valid = TRUE;
+    }
+
+  if (extents->has_gtk)
+    {
+      window_area->x += extents->gtk.left;
+      window_area->y += extents->gtk.top;
+      window_area->width -= extents->gtk.left + extents->gtk.right;
+      window_area->height -= extents->gtk.top + extents->gtk.bottom;
+    }
+  else if (xfw_window_is_shaded (active_window))
+    {
+      /* if a window is shaded, check the height of the window's
+       * decoration as exposed through the _NET_FRAME_EXTENTS application
+       * window property */
+      if (!extents->net_valid)
+        {
+          extents->has_net = panel_window_frame_extents_read (extents->xid, net_frame_extents_atom, &extents->net);
+          extents->net_valid = TRUE;
+        }
+
+      if (extents->has_net)
+        window_area->height = extents->net.top + extents->net.bottom;
+    }
+#endif
+}
+
+
+
+static void
+panel_window_intellihide_check (PanelWindow *window,
+                                const GdkRectangle *active_area)
 {
   GdkRectangle panel_area;
   GdkRectangle window_area;
   gint scale_factor;
 
-  panel_return_if_fail (active_window == NULL || XFW_IS_WINDOW (active_window));
+  /* apply scale factor */
+  scale_factor = gtk_widget_get_scale_factor (GTK_WIDGET (window));
+  window_area.x = active_area->x / scale_factor;
+  window_area.y = active_area->y / scale_factor;
+  window_area.width = active_area->width / scale_factor;
+  window_area.height = active_area->height / scale_factor;
+
+  /* obtain position and dimension from the panel */
+  panel_window_size_allocate_set_xy (window,
+                                     window->alloc.width,
+                                     window->alloc.height,
+                                     &panel_area.x,
+                                     &panel_area.y);
+  gtk_window_get_size (GTK_WINDOW (window),
+                       &panel_area.width,
+                       &panel_area.height);
+
+  /* show/hide the panel, depending on whether the active window overlaps
+   * with its coordinates */
+  if (window->autohide_state != AUTOHIDE_HIDDEN)
+    {
+      if (gdk_rectangle_intersect (&panel_area, &window_area, NULL)
+          && panel_window_pointer_is_outside (window))
+        panel_window_autohide_queue (window, AUTOHIDE_POPDOWN);
+    }
+  else
+    {
+      if (!gdk_rectangle_intersect (&panel_area, &window_area, NULL))
+        panel_window_autohide_queue (window, AUTOHIDE_VISIBLE);
+    }
+}
+
+
+
+static gboolean
+panel_window_intellihide_idle (gpointer data)
+{
+  GSList *windows, *li;
+  PanelWindow *window;
+  XfwWindow *area_window = NULL;
+  GdkRectangle area;
+
+  windows = g_slist_reverse (intellihide_windows);
+  intellihide_windows = NULL;
+  intellihide_idle_id = 0;
+
+  for (li = windows; li != NULL; li = li->next)
+    {
+      window = li->data;
+
+      /* the state may have changed since the check was queued */
+      if (window->xfw_active_window == NULL
+          || window->autohide_behavior != AUTOHIDE_BEHAVIOR_INTELLIGENTLY
+          || window->autohide_block != 0
+          || xfw_window_get_window_type (window->xfw_active_window) == XFW_WINDOW_TYPE_DESKTOP)
+        continue;
+
+      /* all panels share the active window, only look up its area once */
+      if (window->xfw_active_window != area_window)
+        {
+          area_window = window->xfw_active_window;
+          panel_window_active_window_get_area (area_window, &area);
+        }
+
+      panel_window_intellihide_check (window, &area);
+    }
+
+  g_slist_free (windows);
+
+  return G_SOURCE_REMOVE;
+}
+
+
+
+static void
+panel_window_intellihide_queue (PanelWindow *window)
+{
+  if (g_slist_find (intellihide_windows, window) == NULL)
+    intellihide_windows = g_slist_prepend (intellihide_windows, window);
+
+  /* check all panels once before the next frame, instead of on every
+   * geometry change while a window is dragged */
+  if (intellihide_idle_id == 0)
+    intellihide_idle_id = g_idle_add_full (GDK_PRIORITY_REDRAW, panel_window_intellihide_idle, NULL, NULL);
+}
+
+
+
+void
+panel_window_active_window_geometry_changed (PanelWindow *window)
+{
+  XfwWindow *active_window;
+
   panel_return_if_fail (PANEL_IS_WINDOW (window));
 
-  /* ignore if for some reason the active window does not match the one we know */
-  if (G_UNLIKELY (window->xfw_active_window != active_window))
-    return;
+  active_window = window->xfw_active_window;
 
   /* only react to active window geometry changes if we are doing
    * intelligent autohiding */
@@ -3185,92 +3551,7 @@ panel_window_active_window_geometry_changed (XfwWindow *active_window,
         return;
 
       if (xfw_window_get_window_type (active_window) != XFW_WINDOW_TYPE_DESKTOP)
-        {
-#ifdef ENABLE_X11
-          GdkWindow *gdkwindow;
-          GtkBorder extents;
-          gboolean geometry_fixed = FALSE;
-
-          /* obtain position and dimensions from the active window */
-          window_area = *(xfw_window_get_geometry (active_window));
-
-          /* if a window uses client-side decorations, check the _GTK_FRAME_EXTENTS
-           * application window property to get its actual size without the shadows */
-          gdkwindow = gdk_x11_window_foreign_new_for_display (gdk_display_get_default (),
-                                                              xfw_window_x11_get_xid (active_window));
-          if (gdkwindow != NULL)
-            {
-              if (xfce_has_gtk_frame_extents (gdkwindow, &extents))
-                {
-                  window_area.x += extents.left;
-                  window_area.y += extents.top;
-                  window_area.width -= extents.left + extents.right;
-                  window_area.height -= extents.top + extents.bottom;
-                  geometry_fixed = TRUE;
-                }
-
-              g_object_unref (gdkwindow);
-            }
-
-          /* if a window is shaded, check the height of the window's
-           * decoration as exposed through the _NET_FRAME_EXTENTS application
-           * window property */
-          if (!geometry_fixed && xfw_window_is_shaded (active_window))
-            {
-              Display *display;
-              Atom real_type;
-              int real_format;
-              unsigned long items_read, items_left;
-              guint32 *data;
-
-              display = GDK_DISPLAY_XDISPLAY (gdk_display_get_default ());
-              if (XGetWindowProperty (display, xfw_window_x11_get_xid (active_window),
-                                      XInternAtom (display, "_NET_FRAME_EXTENTS", True),
-                                      0, 4, FALSE, AnyPropertyType,
-                                      &real_type, &real_format, &items_read, &items_left,
-                                      (unsigned char **) &data)
-                    == Success
-                  && (items_read >= 4))
-                window_area.height = data[2] + data[3];
-
-              if (data)
-                {
-                  XFree (data);
-                }
-            }
-#endif
-
-          /* apply scale factor */
-          scale_factor = gtk_widget_get_scale_factor (GTK_WIDGET (window));
-          window_area.x /= scale_factor;
-          window_area.y /= scale_factor;
-          window_area.width /= scale_factor;
-          window_area.height /= scale_factor;
-
-          /* obtain position and dimension from the panel */
-          panel_window_size_allocate_set_xy (window,
-                                             window->alloc.width,
-                                             window->alloc.height,
-                                             &panel_area.x,
-                                             &panel_area.y);
-          gtk_window_get_size (GTK_WINDOW (window),
-                               &panel_area.width,
-                               &panel_area.height);
-
-          /* show/hide the panel, depending on whether the active window overlaps
-           * with its coordinates */
-          if (window->autohide_state != AUTOHIDE_HIDDEN)
-            {
-              if (gdk_rectangle_intersect (&panel_area, &window_area, NULL)
-                  && panel_window_pointer_is_outside (window))
-                panel_window_autohide_queue (window, AUTOHIDE_POPDOWN);
-            }
-          else
-            {
-              if (!gdk_rectangle_intersect (&panel_area, &window_area, NULL))
-                panel_window_autohide_queue (window, AUTOHIDE_VISIBLE);
-            }
-        }
+        panel_window_intellihide_queue (window);
       else
         {
           /* make the panel visible if it isn't at the moment and the active
@@ -3285,11 +3566,8 @@ panel_window_active_window_geometry_changed (XfwWindow *active_window,
 
 static gboolean
 panel_window_xfw_window_on_panel_monitor (PanelWindow *window,
-                                          XfwWindow *xfw_window)
+                                          GList *monitors)
 {
-  GList *monitors = NULL;
-
-  monitors = xfw_window_get_monitors (xfw_window);
   if (window->span_monitors)
     {
       GdkMonitor *monitor = NULL, *p_monitor;
@@ -3340,49 +3618,36 @@ panel_window_xfw_window_on_panel_monitor (PanelWindow *window,
 
 
 
-static void
-panel_window_active_window_state_changed (XfwWindow *active_window,
+void
+panel_window_active_window_state_changed (PanelWindow *window,
                                           XfwWindowState changed,
                                           XfwWindowState new,
-                                          PanelWindow *window)
+                                          GList *monitors)
 {
   gboolean maximized;
 
-  panel_return_if_fail (XFW_IS_WINDOW (active_window));
+  panel_return_if_fail (PANEL_IS_WINDOW (window));
 
   if (WINDOWING_IS_X11 ())
     {
       if (changed & XFW_WINDOW_STATE_SHADED)
-        panel_window_active_window_geometry_changed (active_window, window);
+        panel_window_active_window_geometry_changed (window);
 
       return;
     }
 
+  /* only panels on a monitor of the active window are affected */
   maximized = XFW_WINDOW_STATE_MAXIMIZED & new;
   if (maximized != window->wl_active_is_maximized
-      && panel_window_xfw_window_on_panel_monitor (window, active_window))
+      && panel_window_xfw_window_on_panel_monitor (window, monitors))
     {
       window->wl_active_is_maximized = maximized;
-      panel_window_active_window_geometry_changed (active_window, window);
+      panel_window_active_window_geometry_changed (window);
     }
 }
 
 
 
-static void
-panel_window_active_window_monitors (XfwWindow *active_window,
-                                     GParamSpec *pspec,
-                                     PanelWindow *window)
-{
-  panel_return_if_fail (XFW_IS_WINDOW (active_window));
-
-  panel_window_active_window_state_changed (active_window, 0,
-                                            xfw_window_get_state (active_window),
-                                            window);
-}
-
-
-
 static void
 panel_window_xfw_window_closed (XfwWindow *xfw_window,
                                 PanelWindow *window)
@@ -3399,7 +3664,7 @@ panel_window_xfw_window_closed (XfwWindow *xfw_window,
   for (lp = windows; lp != NULL; lp = lp->next)
     if (lp->data != xfw_window
         && xfw_window_get_state (lp->data) & XFW_WINDOW_STATE_MAXIMIZED
-        && panel_window_xfw_window_on_panel_monitor (window, lp->data))
+        && panel_window_xfw_window_on_panel_monitor (window, xfw_window_get_monitors (lp->data)))
       {
         g_signal_handlers_disconnect_by_func (lp->data, panel_window_xfw_window_closed, window);
         g_signal_connect_object (lp->data, "closed",
@@ -3410,7 +3675,7 @@ panel_window_xfw_window_closed (XfwWindow *xfw_window,
   if (lp == NULL)
     {
       window->wl_active_is_maximized = FALSE;
-      panel_window_active_window_geometry_changed (window->xfw_active_window, window);
+      panel_window_active_window_geometry_changed (window);
     }
 }
 
@@ -3473,9 +3738,9 @@ panel_window_autohide_timeout (gpointer user_data)
 
   /* check whether the panel should be animated on autohide */
   if (!window->floating || window->popdown_speed > 0)
-    window->autohide_ease_out_id = g_timeout_add_full (G_PRIORITY_LOW, 25,
-                                                       panel_window_autohide_ease_out, window,
-                                                       panel_window_autohide_ease_out_timeout_destroy);
+    window->autohide_ease_out_id = gtk_widget_add_tick_callback (GTK_WIDGET (window),
+                                                                 panel_window_autohide_ease_out, window,
+                                                                 panel_window_autohide_ease_out_destroy);
 
   return FALSE;
 }
@@ -3488,7 +3753,7 @@ panel_window_autohide_timeout_destroy (gpointer user_data)
   PanelWindow *window = user_data;
 
   window->autohide_timeout_id = 0;
-  window->popdown_progress = -G_MAXINT;
+  window->popdown_progress = -1.0;
 }
 
 
@@ -3496,89 +3761,172 @@ panel_window_autohide_timeout_destroy (gpointer user_data)
 /* Cubic ease out function based on Robert Penner's Easing Functions,
    which are licensed under MIT and BSD license
    http://robertpenner.com/easing/ */
-static guint
-panel_window_cubic_ease_out (guint p)
+static gdouble
+panel_window_cubic_ease_out (gdouble p)
+{
+  gdouble f = (p - 1.0);
+  return f * f * f + 1.0;
+}
+
+
+
+static void
+panel_window_autohide_show_child_window (GtkWidget *widget,
+                                         gpointer data)
+{
+  gboolean show = GPOINTER_TO_INT (data);
+
+  /* widgets with their own window, like the sockets of external plugins, are
+   * not drawn by the panel window, so hide them while the panel slides */
+  if (gtk_widget_get_has_window (widget))
+    {
+      if (gtk_widget_get_mapped (widget))
+        {
+          if (show)
+            gdk_window_show_unraised (gtk_widget_get_window (widget));
+          else
+            gdk_window_hide (gtk_widget_get_window (widget));
+        }
+    }
+  else if (GTK_IS_CONTAINER (widget))
+    gtk_container_forall (GTK_CONTAINER (widget), panel_window_autohide_show_child_window, data);
+}
+
+
+
+static void
+panel_window_autohide_set_offset (PanelWindow *window,
+                                  gint offset_x,
+                                  gint offset_y)
 {
-  guint f = (p - 1);
-  return f * f * f + 1;
+  GdkWindow *gdkwindow;
+  GtkWidget *itembar;
+  cairo_rectangle_int_t rect;
+  cairo_region_t *region;
+  gboolean was_sliding;
+
+  if (window->popdown_offset_x == offset_x && window->popdown_offset_y == offset_y)
+    return;
+
+  was_sliding = window->popdown_offset_x != 0 || window->popdown_offset_y != 0;
+
+  window->popdown_offset_x = offset_x;
+  window->popdown_offset_y = offset_y;
+
+  gdkwindow = gtk_widget_get_window (GTK_WIDGET (window));
+  if (gdkwindow == NULL)
+    return;
+
+  /* only the part of the panel that is still visible accepts input */
+  if (offset_x == 0 && offset_y == 0)
+    gdk_window_input_shape_combine_region (gdkwindow, NULL, 0, 0);
+  else
+    {
+      rect.x = MAX (offset_x, 0);
+      rect.y = MAX (offset_y, 0);
+      rect.width = MAX (window->alloc.width - ABS (offset_x), 0);
+      rect.height = MAX (window->alloc.height - ABS (offset_y), 0);
+      region = cairo_region_create_rectangle (&rect);
+      gdk_window_input_shape_combine_region (gdkwindow, region, 0, 0);
+      cairo_region_destroy (region);
+    }
+
+  /* unmap the child windows once when the slide starts and map them again
+   * when it ends, instead of configuring them every frame */
+  itembar = gtk_bin_get_child (GTK_BIN (window));
+  if (itembar != NULL && was_sliding != (offset_x != 0 || offset_y != 0))
+    panel_window_autohide_show_child_window (itembar, GINT_TO_POINTER (was_sliding));
+
+  gtk_widget_queue_draw (GTK_WIDGET (window));
 }
 
 
 
 static gboolean
-panel_window_autohide_ease_out (gpointer data)
+panel_window_autohide_ease_out (GtkWidget *widget,
+                                GdkFrameClock *frame_clock,
+                                gpointer user_data)
 {
-  PanelWindow *window = PANEL_WINDOW (data);
-  gint x, y, w, h, progress;
-  gboolean ret = TRUE;
+  PanelWindow *window = PANEL_WINDOW (user_data);
+  gint64 frame_time, duration;
+  gint x, y, end_x, end_y;
+  gdouble eased;
 
-  if (window->autohide_ease_out_id == 0)
-    return FALSE;
+  frame_time = gdk_frame_clock_get_frame_time (frame_clock);
 
-  panel_window_get_position (window, &x, &y);
-  w = panel_screen_get_width (window->screen);
-  h = panel_screen_get_height (window->screen);
+  /* first frame of the animation, slide out from the current position */
+  if (window->popdown_start_time == 0)
+    {
+      window->popdown_start_time = frame_time;
+      panel_window_get_position (window, &window->popdown_start_x, &window->popdown_start_y);
 
-  /* may be true on wayland where gtk_widget_queue_resize() does not always trigger size_allocate() */
-  if (window->popdown_progress == -G_MAXINT)
-    window->popdown_progress = IS_HORIZONTAL (window) ? window->alloc.height : window->alloc.width;
+      /* with a compositor on X11, keep the window where it is and only move
+       * it once the slide is over, instead of configuring it every frame */
+      window->popdown_in_place = !gtk_layer_is_supported ()
+                                 && panel_base_window_is_composited (PANEL_BASE_WINDOW (window));
+    }
+
+  /* progress depends on the elapsed time only, so the animation takes as long
+   * on every refresh rate and the window is moved once per frame */
+  duration = (gint64) window->popdown_speed * POPDOWN_SPEED_DURATION * G_TIME_SPAN_MILLISECOND;
+  if (duration > 0)
+    window->popdown_progress = MIN ((gdouble) (frame_time - window->popdown_start_time) / duration, 1.0);
+  else
+    window->popdown_progress = 1.0;
 
+  /* move the panel out of the screen edge it is attached to */
+  end_x = x = window->popdown_start_x;
+  end_y = y = window->popdown_start_y;
   if (IS_HORIZONTAL (window))
     {
-      progress = panel_window_cubic_ease_out (window->alloc.height - window->popdown_progress) / window->popdown_speed;
       if (window->snap_position == SNAP_POSITION_N || window->snap_position == SNAP_POSITION_NC
           || window->snap_position == SNAP_POSITION_NW || window->snap_position == SNAP_POSITION_NE)
-        {
-          y -= progress;
-
-          if (y < 0 - window->alloc.height)
-            ret = FALSE;
-        }
+        end_y = -window->alloc.height;
       else if (window->snap_position == SNAP_POSITION_S || window->snap_position == SNAP_POSITION_SC
                || window->snap_position == SNAP_POSITION_SW || window->snap_position == SNAP_POSITION_SE)
-        {
-          y += progress;
-
-          if (y > h + window->alloc.height)
-            ret = FALSE;
-        }
+        end_y = panel_screen_get_height (window->screen);
     }
   else
     {
-      progress = panel_window_cubic_ease_out (window->alloc.width - window->popdown_progress) / window->popdown_speed;
       if (window->snap_position == SNAP_POSITION_W || window->snap_position == SNAP_POSITION_WC
           || window->snap_position == SNAP_POSITION_NW || window->snap_position == SNAP_POSITION_SW)
-        {
-          x -= progress;
-
-          if (x < 0 - window->alloc.width)
-            ret = FALSE;
-        }
+        end_x = -window->alloc.width;
       else if (window->snap_position == SNAP_POSITION_E || window->snap_position == SNAP_POSITION_EC
                || window->snap_position == SNAP_POSITION_NE || window->snap_position == SNAP_POSITION_SE)
-        {
-          x += progress;
-
-          if (x > (w + window->alloc.width))
-            ret = FALSE;
-        }
+        end_x = panel_screen_get_width (window->screen);
     }
 
-  window->popdown_progress--;
-  panel_window_move (window, GTK_WINDOW (window), x, y);
+  eased = panel_window_cubic_ease_out (window->popdown_progress);
+  x += (end_x - x) * eased;
+  y += (end_y - y) * eased;
 
-  return ret;
+  if (window->popdown_in_place && window->popdown_progress < 1.0)
+    {
+      panel_window_autohide_set_offset (window, x - window->popdown_start_x,
+                                        y - window->popdown_start_y);
+    }
+  else
+    {
+      panel_window_move (window, GTK_WINDOW (window), x, y);
+      panel_window_autohide_set_offset (window, 0, 0);
+    }
+
+  return window->popdown_progress < 1.0 ? G_SOURCE_CONTINUE : G_SOURCE_REMOVE;
 }
 
 
 
 static void
-panel_window_autohide_ease_out_timeout_destroy (gpointer user_data)
+panel_window_autohide_ease_out_destroy (gpointer user_data)
 {
   PanelWindow *window = user_data;
 
   window->autohide_ease_out_id = 0;
-  window->popdown_progress = -G_MAXINT;
+  window->popdown_progress = -1.0;
+  window->popdown_start_time = 0;
+
+  /* the slide was interrupted, show the panel at its real position again */
+  panel_window_autohide_set_offset (window, 0, 0);
 }
 
 
@@ -3596,7 +3944,7 @@ panel_window_autohide_queue (PanelWindow *window,
     g_source_remove (window->autohide_timeout_id);
 
   if (window->autohide_ease_out_id != 0)
-    g_source_remove (window->autohide_ease_out_id);
+    gtk_widget_remove_tick_callback (GTK_WIDGET (window), window->autohide_ease_out_id);
 
   /* set new autohide state */
   if (new_state == AUTOHIDE_VISIBLE
@@ -3864,11 +4212,8 @@ panel_window_update_xfw_screen (PanelWindow *window,
   /* disconnect from previous screen */
   if (G_LIKELY (window->xfw_screen != NULL))
     {
-      panel_window_update_active_window (window, NULL);
-      g_signal_handlers_disconnect_by_func (window->xfw_screen,
-                                            panel_window_active_window_changed, window);
       g_signal_handlers_disconnect_by_func (window->xfw_screen,
-                                            panel_window_screen_layout_changed, window);
+                                            panel_window_screen_monitors_changed, window);
       g_object_unref (window->xfw_screen);
     }
 
@@ -3879,11 +4224,8 @@ panel_window_update_xfw_screen (PanelWindow *window,
   if (screen != NULL)
     {
       panel_window_screen_layout_changed (screen, window);
-      panel_window_active_window_changed (screen, NULL, window);
       g_signal_connect (G_OBJECT (screen), "monitors-changed",
-                        G_CALLBACK (panel_window_screen_layout_changed), window);
-      g_signal_connect (G_OBJECT (screen), "active-window-changed",
-                        G_CALLBACK (panel_window_active_window_changed), window);
+                        G_CALLBACK (panel_window_screen_monitors_changed), window);
     }
 }
 
@@ -4076,54 +4418,91 @@ panel_window_menu_popup (PanelWindow *window,
 
 static void
 panel_window_plugins_update (PanelWindow *window,
-                             PluginProp prop)
+                             PluginProp props)
 {
   GtkWidget *itembar;
-  GtkCallback func;
 
   panel_return_if_fail (PANEL_IS_WINDOW (window));
 
-  switch (prop)
+  if (props == 0)
+    return;
+
+  /* pending properties are sent along, so plugins get them in order */
+  props |= window->plugins_update_props;
+  window->plugins_update_props = 0;
+  if (window->plugins_update_id != 0)
     {
-    case PLUGIN_PROP_HIDDEN_EVENT:
-      func = panel_window_plugin_emit_hidden_event;
-      break;
+      g_source_remove (window->plugins_update_id);
+      window->plugins_update_id = 0;
+    }
 
-    case PLUGIN_PROP_MODE:
-      func = panel_window_plugin_set_mode;
-      break;
+  itembar = gtk_bin_get_child (GTK_BIN (window));
+  if (G_LIKELY (itembar != NULL))
+    {
+      panel_return_if_fail (GTK_IS_CONTAINER (itembar));
 
-    case PLUGIN_PROP_SCREEN_POSITION:
-      func = panel_window_plugin_set_screen_position;
-      break;
+      /* walk the plugins once and apply all properties to each of them */
+      window->plugins_update_current = props;
+      gtk_container_foreach (GTK_CONTAINER (itembar), panel_window_plugin_update, window);
+      window->plugins_update_current = 0;
+    }
+}
 
-    case PLUGIN_PROP_NROWS:
-      func = panel_window_plugin_set_nrows;
-      break;
 
-    case PLUGIN_PROP_SIZE:
-      func = panel_window_plugin_set_size;
-      break;
 
-    case PLUGIN_PROP_ICON_SIZE:
-      func = panel_window_plugin_set_icon_size;
-      break;
+static gboolean
+panel_window_plugins_update_idle (gpointer data)
+{
+  PanelWindow *window = data;
 
-    case PLUGIN_PROP_DARK_MODE:
-      func = panel_window_plugin_set_dark_mode;
-      break;
+  window->plugins_update_id = 0;
+  panel_window_plugins_update (window, window->plugins_update_props);
 
-    default:
-      panel_assert_not_reached ();
-      return;
-    }
+  return G_SOURCE_REMOVE;
+}
 
-  itembar = gtk_bin_get_child (GTK_BIN (window));
-  if (G_LIKELY (itembar != NULL))
-    {
-      panel_return_if_fail (GTK_IS_CONTAINER (itembar));
-      gtk_container_foreach (GTK_CONTAINER (itembar), func, window);
-    }
+
+
+static void
+panel_window_plugins_queue_update (PanelWindow *window,
+                                   PluginProp props)
+{
+  panel_return_if_fail (PANEL_IS_WINDOW (window));
+
+  /* properties are often changed together (e.g. by xfconf or the preferences
+   * dialog), send them in one pass before the next size allocation */
+  window->plugins_update_props |= props;
+  if (window->plugins_update_id == 0)
+    window->plugins_update_id = g_idle_add_full (G_PRIORITY_HIGH_IDLE, panel_window_plugins_update_idle,
+                                                 window, NULL);
+}
+
+
+
+static void
+panel_window_plugin_update (GtkWidget *widget,
+                            gpointer user_data)
+{
+  PanelWindow *window = PANEL_WINDOW (user_data);
+  PluginProp props = window->plugins_update_current;
+
+  panel_return_if_fail (XFCE_IS_PANEL_PLUGIN_PROVIDER (widget));
+
+  /* same order as in panel_window_set_provider_info() */
+  if (props & PLUGIN_PROP_MODE)
+    panel_window_plugin_set_mode (widget, window);
+  if (props & PLUGIN_PROP_SCREEN_POSITION)
+    panel_window_plugin_set_screen_position (widget, window);
+  if (props & PLUGIN_PROP_SIZE)
+    panel_window_plugin_set_size (widget, window);
+  if (props & PLUGIN_PROP_ICON_SIZE)
+    panel_window_plugin_set_icon_size (widget, window);
+  if (props & PLUGIN_PROP_DARK_MODE)
+    panel_window_plugin_set_dark_mode (widget, window);
+  if (props & PLUGIN_PROP_NROWS)
+    panel_window_plugin_set_nrows (widget, window);
+  if (props & PLUGIN_PROP_HIDDEN_EVENT)
+    panel_window_plugin_emit_hidden_event (widget, window);
 }
 
 
@@ -4406,7 +4785,7 @@ panel_window_thaw_autohide (PanelWindow *window)
     {
       /* simulate a geometry change to check for overlapping windows with intelligent hiding */
       if (window->autohide_behavior == AUTOHIDE_BEHAVIOR_INTELLIGENTLY)
-        panel_window_active_window_geometry_changed (window->xfw_active_window, window);
+        panel_window_active_window_geometry_changed (window);
       /* otherwise hide the panel if the pointer is outside */
       else if (outside)
         panel_window_autohide_queue (window, AUTOHIDE_POPDOWN);
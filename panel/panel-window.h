@@ -24,6 +24,7 @@
 #include "common/panel-xfconf.h"
 
 #include <gtk/gtk.h>
+#include <libxfce4windowing/libxfce4windowing.h>
 #include <xfconf/xfconf.h>
 
 #define DEFAULT_MODE XFCE_PANEL_PLUGIN_MODE_HORIZONTAL
@@ -85,6 +86,19 @@ panel_window_migrate_old_properties (PanelWindow *window,
 gboolean
 panel_window_pointer_is_outside (PanelWindow *window);
 
+void
+panel_window_set_active_window (PanelWindow *window,
+                                XfwWindow *active_window);
+
+void
+panel_window_active_window_geometry_changed (PanelWindow *window);
+
+void
+panel_window_active_window_state_changed (PanelWindow *window,
+                                          XfwWindowState changed,
+                                          XfwWindowState new,
+                                          GList *monitors);
+
 G_END_DECLS
 
 #endif /* !__PANEL_WINDOW_H__ */
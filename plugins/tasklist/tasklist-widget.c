@@ -19,6 +19,7 @@
 #include "tasklist-widget.h"
 
 #include "common/panel-debug.h"
+#include "common/panel-icon-cache.h"
 #include "common/panel-private.h"
 #include "common/panel-utils.h"
 
@@ -72,6 +73,7 @@
 #define ARROW_BUTTON_SIZE (20)
 #define WIREFRAME_SIZE (5) /* same as xfwm4 */
 #define DRAG_ACTIVATE_TIMEOUT (500)
+#define ICON_GEOMETRIES_INTERVAL (100) /* ms */
 
 
 /* locking helpers for tasklist->locked */
@@ -167,6 +169,20 @@ struct _XfceTasklist
   /* window children in the tasklist */
   GList *windows;
 
+  /* window buttons indexed by their window and by their workspace,
+   * pinned windows are in the NULL workspace */
+  GHashTable *window_children;
+  GHashTable *workspace_children;
+
+  /* window buttons currently in the overflow menu */
+  GSList *overflow_children;
+
+  /* windows opened since the last frame, their buttons are created
+   * together in an idle that runs before the next layout */
+  GPtrArray *pending_windows;
+  guint pending_windows_id;
+  guint sort_deferred : 1;
+
   /* windows we monitor, but that are excluded from the tasklist */
   GSList *skipped_windows;
 
@@ -225,8 +241,9 @@ struct _XfceTasklist
    * the tasklist */
   guint show_wireframes : 1;
 
-  /* icon geometries update timeout */
+  /* icon geometries update timeout and time of the last update */
   guint update_icon_geometries_id;
+  gint64 update_icon_geometries_time;
 
   /* idle monitor geometry update */
   guint update_monitor_geometry_id;
@@ -300,6 +317,17 @@ typedef struct _XfceTasklistChild
   /* xfw information */
   XfwWindow *window;
   XfwApplication *app;
+
+  /* workspace bucket of a window button, also used for sorting */
+  XfwWorkspace *workspace;
+
+  /* last icon geometry published for the window */
+  GdkWindow *icon_geometry_window;
+  GdkRectangle icon_geometry;
+
+  /* cached sort keys, refreshed when the window or app changes */
+  gchar *group_key;
+  gchar *title_key;
 } XfceTasklistChild;
 
 static const GtkTargetEntry source_targets[] = {
@@ -393,6 +421,10 @@ xfce_tasklist_button_state_changed (XfwWindow *window,
                                     XfwWindowState new_state,
                                     XfceTasklistChild *child);
 static void
+xfce_tasklist_button_app_name_changed (XfwApplication *app,
+                                       GParamSpec *pspec,
+                                       XfceTasklistChild *child);
+static void
 xfce_tasklist_skipped_windows_state_changed (XfwWindow *window,
                                              XfwWindowState changed_state,
                                              XfwWindowState new_state,
@@ -402,6 +434,12 @@ xfce_tasklist_sort (XfceTasklist *tasklist,
                     gboolean sort_groups);
 static void
 xfce_tasklist_group_button_sort (XfceTasklistChild *group_child);
+static void
+xfce_tasklist_child_update_sort_keys (XfceTasklistChild *child);
+static void
+xfce_tasklist_child_reposition (XfceTasklistChild *child);
+static void
+xfce_tasklist_queue_update_icon_geometries (XfceTasklist *tasklist);
 static gboolean
 xfce_tasklist_update_icon_geometries (gpointer data);
 static void
@@ -697,6 +735,13 @@ xfce_tasklist_init (XfceTasklist *tasklist)
   tasklist->locked = 0;
   tasklist->screen = NULL;
   tasklist->windows = NULL;
+  tasklist->window_children = g_hash_table_new (g_direct_hash, g_direct_equal);
+  tasklist->workspace_children = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                                        NULL, (GDestroyNotify) g_ptr_array_unref);
+  tasklist->overflow_children = NULL;
+  tasklist->pending_windows = g_ptr_array_new_with_free_func (g_object_unref);
+  tasklist->pending_windows_id = 0;
+  tasklist->sort_deferred = FALSE;
   tasklist->skipped_windows = NULL;
   tasklist->mode = XFCE_PANEL_PLUGIN_MODE_HORIZONTAL;
   tasklist->nrows = 1;
@@ -719,6 +764,7 @@ xfce_tasklist_init (XfceTasklist *tasklist)
   tasklist->wireframe_window = 0;
 #endif
   tasklist->update_icon_geometries_id = 0;
+  tasklist->update_icon_geometries_time = 0;
   tasklist->update_monitor_geometry_id = 0;
   tasklist->max_button_length = DEFAULT_MAX_BUTTON_LENGTH;
   tasklist->min_button_length = DEFAULT_MIN_BUTTON_LENGTH;
@@ -927,6 +973,12 @@ xfce_tasklist_finalize (GObject *object)
   panel_return_if_fail (tasklist->skipped_windows == NULL);
   panel_return_if_fail (tasklist->screen == NULL);
 
+  panel_return_if_fail (g_hash_table_size (tasklist->window_children) == 0);
+
+  g_hash_table_destroy (tasklist->window_children);
+  g_hash_table_destroy (tasklist->workspace_children);
+  g_ptr_array_unref (tasklist->pending_windows);
+
   /* stop pending timeouts */
   if (tasklist->update_icon_geometries_id != 0)
     g_source_remove (tasklist->update_icon_geometries_id);
@@ -1112,12 +1164,13 @@ xfce_tasklist_size_layout (XfceTasklist *tasklist,
 
   /* unset overflow items, we decide about that again
    * later */
-  for (li = tasklist->windows; li != NULL; li = li->next)
+  for (lp = tasklist->overflow_children; lp != NULL; lp = lp->next)
     {
-      child = li->data;
+      child = lp->data;
       if (child->type == CHILD_TYPE_OVERFLOW_MENU)
         child->type = CHILD_TYPE_WINDOW;
     }
+  g_clear_slist (&tasklist->overflow_children, NULL);
 
   if (min_button_length * cols <= alloc->width)
     {
@@ -1168,6 +1221,7 @@ xfce_tasklist_size_layout (XfceTasklist *tasklist,
             {
               child = lp->data;
               child->type = CHILD_TYPE_OVERFLOW_MENU;
+              tasklist->overflow_children = g_slist_prepend (tasklist->overflow_children, child);
             }
 
           /* Try to position the arrow widget at the end of the allocation area  *
@@ -1332,9 +1386,7 @@ xfce_tasklist_size_allocate (GtkWidget *widget,
     }
 
   /* update icon geometries */
-  if (tasklist->update_icon_geometries_id == 0)
-    tasklist->update_icon_geometries_id = g_idle_add_full (G_PRIORITY_LOW, xfce_tasklist_update_icon_geometries,
-                                                           tasklist, xfce_tasklist_update_icon_geometries_destroyed);
+  xfce_tasklist_queue_update_icon_geometries (tasklist);
 }
 
 
@@ -1526,7 +1578,72 @@ xfce_tasklist_scroll_event (GtkWidget *widget,
 static void
 xfce_tasklist_free_child (gpointer data)
 {
-  g_slice_free (XfceTasklistChild, data);
+  XfceTasklistChild *child = data;
+
+  g_free (child->group_key);
+  g_free (child->title_key);
+  g_slice_free (XfceTasklistChild, child);
+}
+
+
+
+static void
+xfce_tasklist_workspace_index_add (XfceTasklist *tasklist,
+                                   XfceTasklistChild *child)
+{
+  GPtrArray *bucket;
+
+  child->workspace = xfw_window_get_workspace (child->window);
+
+  bucket = g_hash_table_lookup (tasklist->workspace_children, child->workspace);
+  if (bucket == NULL)
+    {
+      bucket = g_ptr_array_new ();
+      g_hash_table_insert (tasklist->workspace_children, child->workspace, bucket);
+    }
+
+  g_ptr_array_add (bucket, child);
+}
+
+
+
+static void
+xfce_tasklist_workspace_index_remove (XfceTasklist *tasklist,
+                                      XfceTasklistChild *child)
+{
+  GPtrArray *bucket;
+
+  bucket = g_hash_table_lookup (tasklist->workspace_children, child->workspace);
+  if (bucket != NULL)
+    {
+      g_ptr_array_remove_fast (bucket, child);
+      if (bucket->len == 0)
+        g_hash_table_remove (tasklist->workspace_children, child->workspace);
+    }
+
+  child->workspace = NULL;
+}
+
+
+
+static void
+xfce_tasklist_window_index_add (XfceTasklist *tasklist,
+                                XfceTasklistChild *child)
+{
+  panel_return_if_fail (XFW_IS_WINDOW (child->window));
+
+  g_hash_table_insert (tasklist->window_children, child->window, child);
+  xfce_tasklist_workspace_index_add (tasklist, child);
+}
+
+
+
+static void
+xfce_tasklist_window_index_remove (XfceTasklist *tasklist,
+                                   XfceTasklistChild *child)
+{
+  g_hash_table_remove (tasklist->window_children, child->window);
+  xfce_tasklist_workspace_index_remove (tasklist, child);
 }
 
 
@@ -1547,6 +1664,9 @@ xfce_tasklist_remove (GtkContainer *container,
       if (child->button == widget)
         {
           tasklist->windows = g_list_delete_link (tasklist->windows, li);
+          tasklist->overflow_children = g_slist_remove (tasklist->overflow_children, child);
+          if (child->type != CHILD_TYPE_GROUP)
+            xfce_tasklist_window_index_remove (tasklist, child);
 
           was_visible = gtk_widget_get_visible (widget);
 
@@ -1773,6 +1893,14 @@ xfce_tasklist_disconnect_screen (XfceTasklist *tasklist)
   panel_return_if_fail (XFCE_IS_TASKLIST (tasklist));
   panel_return_if_fail (XFW_IS_SCREEN (tasklist->screen));
 
+  /* drop the windows that did not get a button yet */
+  if (tasklist->pending_windows_id != 0)
+    {
+      g_source_remove (tasklist->pending_windows_id);
+      tasklist->pending_windows_id = 0;
+    }
+  g_ptr_array_set_size (tasklist->pending_windows, 0);
+
   /* disconnect configure-event signal */
   g_signal_handlers_disconnect_by_func (
     G_OBJECT (gtk_widget_get_toplevel (GTK_WIDGET (tasklist))),
@@ -1899,6 +2027,34 @@ xfce_tasklist_active_window_changed (XfwScreen *screen,
 
 
 
+static void
+xfce_tasklist_workspace_update_visibility (XfceTasklist *tasklist,
+                                           XfwWorkspace *workspace,
+                                           XfwWorkspace *active_ws)
+{
+  GPtrArray *bucket, *children;
+  XfceTasklistChild *child;
+  guint i;
+
+  bucket = g_hash_table_lookup (tasklist->workspace_children, workspace);
+  if (bucket == NULL)
+    return;
+
+  /* work on a copy, see xfce_tasklist_active_workspace_changed() */
+  children = g_ptr_array_copy (bucket, NULL, NULL);
+  for (i = 0; i < children->len; i++)
+    {
+      child = g_ptr_array_index (children, i);
+      if (xfce_tasklist_button_visible (child, active_ws))
+        gtk_widget_show (child->button);
+      else
+        gtk_widget_hide (child->button);
+    }
+  g_ptr_array_unref (children);
+}
+
+
+
 static void
 xfce_tasklist_active_workspace_changed (XfwWorkspaceGroup *group,
                                         XfwWorkspace *previous_workspace,
@@ -1921,10 +2077,23 @@ xfce_tasklist_active_workspace_changed (XfwWorkspaceGroup *group,
           && tasklist->all_workspaces))
     return;
 
+  /* on a plain workspace switch only the windows of the previous and the
+   * new workspace change visibility, pinned windows are shown on both */
+  active_ws = xfw_workspace_group_get_active_workspace (group);
+  if (previous_workspace != NULL
+      && previous_workspace != active_ws
+      && active_ws != NULL
+      && !PANEL_HAS_FLAG (xfw_workspace_get_state (previous_workspace), XFW_WORKSPACE_STATE_VIRTUAL)
+      && !PANEL_HAS_FLAG (xfw_workspace_get_state (active_ws), XFW_WORKSPACE_STATE_VIRTUAL))
+    {
+      xfce_tasklist_workspace_update_visibility (tasklist, previous_workspace, active_ws);
+      xfce_tasklist_workspace_update_visibility (tasklist, active_ws, active_ws);
+      return;
+    }
+
   /* walk all the children and update their visibility: make a copy of the window list
    * here because changing the buttons visibility can change the group buttons visibility,
    * which in turn can change the list order */
-  active_ws = xfw_workspace_group_get_active_workspace (group);
   windows = g_list_copy (tasklist->windows);
   for (li = windows; li != NULL; li = li->next)
     {
@@ -1944,18 +2113,12 @@ xfce_tasklist_active_workspace_changed (XfwWorkspaceGroup *group,
 
 
 static void
-xfce_tasklist_window_added (XfwScreen *screen,
-                            XfwWindow *window,
-                            XfceTasklist *tasklist)
+xfce_tasklist_window_add (XfceTasklist *tasklist,
+                          XfwWindow *window,
+                          XfwWorkspace *active_ws)
 {
   XfceTasklistChild *child;
 
-  panel_return_if_fail (XFW_IS_SCREEN (screen));
-  panel_return_if_fail (XFW_IS_WINDOW (window));
-  panel_return_if_fail (XFCE_IS_TASKLIST (tasklist));
-  panel_return_if_fail (tasklist->screen == screen);
-  panel_return_if_fail (xfw_window_get_screen (window) == screen);
-
   /* ignore this window, but watch it for state changes */
   if (xfw_window_is_skip_tasklist (window))
     {
@@ -1970,7 +2133,7 @@ xfce_tasklist_window_added (XfwScreen *screen,
   child = xfce_tasklist_button_new (window, tasklist);
 
   /* initial visibility of the function */
-  if (xfce_tasklist_button_visible (child, xfw_workspace_group_get_active_workspace (tasklist->workspace_group)))
+  if (xfce_tasklist_button_visible (child, active_ws))
     gtk_widget_show (child->button);
 
   if (tasklist->grouping)
@@ -1990,8 +2153,63 @@ xfce_tasklist_window_added (XfwScreen *screen,
   /* set urgency blinking if needed */
   if (xfw_window_is_urgent (window))
     xfce_tasklist_button_state_changed (window, XFW_WINDOW_STATE_URGENT, XFW_WINDOW_STATE_URGENT, child);
+}
 
-  gtk_widget_queue_resize (GTK_WIDGET (tasklist));
+
+
+static gboolean
+xfce_tasklist_pending_windows_idle (gpointer data)
+{
+  XfceTasklist *tasklist = XFCE_TASKLIST (data);
+  GPtrArray *windows;
+  XfwWorkspace *active_ws;
+
+  tasklist->pending_windows_id = 0;
+
+  panel_return_val_if_fail (XFW_IS_SCREEN (tasklist->screen), FALSE);
+
+  /* steal the array, adding a button can emit signals that queue more windows */
+  windows = tasklist->pending_windows;
+  tasklist->pending_windows = g_ptr_array_new_with_free_func (g_object_unref);
+
+  panel_debug_filtered (PANEL_DEBUG_TASKLIST, "adding %u windows", windows->len);
+
+  /* buttons are prepended and the list is sorted once at the end */
+  active_ws = xfw_workspace_group_get_active_workspace (tasklist->workspace_group);
+  tasklist->sort_deferred = TRUE;
+  for (guint i = 0; i < windows->len; i++)
+    xfce_tasklist_window_add (tasklist, g_ptr_array_index (windows, i), active_ws);
+  tasklist->sort_deferred = FALSE;
+
+  g_ptr_array_unref (windows);
+
+  xfce_tasklist_sort (tasklist, FALSE);
+
+  /* the active window might have been one of the new windows */
+  xfce_tasklist_active_window_changed (tasklist->screen, NULL, tasklist);
+
+  return FALSE;
+}
+
+
+
+static void
+xfce_tasklist_window_added (XfwScreen *screen,
+                            XfwWindow *window,
+                            XfceTasklist *tasklist)
+{
+  panel_return_if_fail (XFW_IS_SCREEN (screen));
+  panel_return_if_fail (XFW_IS_WINDOW (window));
+  panel_return_if_fail (XFCE_IS_TASKLIST (tasklist));
+  panel_return_if_fail (tasklist->screen == screen);
+  panel_return_if_fail (xfw_window_get_screen (window) == screen);
+
+  /* buffer the window, so a burst of new windows results in
+   * a single sort and layout of the tasklist */
+  g_ptr_array_add (tasklist->pending_windows, g_object_ref (window));
+  if (tasklist->pending_windows_id == 0)
+    tasklist->pending_windows_id = g_idle_add_full (G_PRIORITY_HIGH_IDLE, xfce_tasklist_pending_windows_idle,
+                                                    tasklist, NULL);
 }
 
 
@@ -2001,7 +2219,6 @@ xfce_tasklist_window_removed (XfwScreen *screen,
                               XfwWindow *window,
                               XfceTasklist *tasklist)
 {
-  GList *li;
   GSList *lp;
   XfceTasklistChild *child;
   guint n;
@@ -2011,6 +2228,10 @@ xfce_tasklist_window_removed (XfwScreen *screen,
   panel_return_if_fail (XFCE_IS_TASKLIST (tasklist));
   panel_return_if_fail (tasklist->screen == screen);
 
+  /* the window is closed before it got a button */
+  if (g_ptr_array_remove (tasklist->pending_windows, window))
+    return;
+
   /* check if the window is in our skipped window list */
   if (xfw_window_is_skip_tasklist (window)
       && (lp = g_slist_find (tasklist->skipped_windows, window)) != NULL)
@@ -2022,34 +2243,30 @@ xfce_tasklist_window_removed (XfwScreen *screen,
     }
 
   /* remove the child from the taskbar */
-  for (li = tasklist->windows; li != NULL; li = li->next)
+  child = g_hash_table_lookup (tasklist->window_children, window);
+  if (child != NULL)
     {
-      child = li->data;
-
-      if (child->window == window)
-        {
-          /* disconnect from all the window watch functions */
-          panel_return_if_fail (XFW_IS_WINDOW (window));
-          n = g_signal_handlers_disconnect_matched (G_OBJECT (window),
-                                                    G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, child);
+      /* disconnect from all the window watch functions */
+      n = g_signal_handlers_disconnect_matched (G_OBJECT (window),
+                                                G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, child);
 
 #ifdef ENABLE_X11
-          /* hide the wireframe */
-          if (G_UNLIKELY (n > 6 && tasklist->show_wireframes))
-            {
-              xfce_tasklist_wireframe_hide (tasklist);
-              n--;
-            }
+      /* hide the wireframe */
+      if (G_UNLIKELY (n > 6 && tasklist->show_wireframes))
+        {
+          xfce_tasklist_wireframe_hide (tasklist);
+          n--;
+        }
 #endif
 
-          panel_return_if_fail (n == 6);
+      panel_return_if_fail (n == 6);
 
-          /* destroy the button, this will free the child data in the
-           * container remove function */
-          gtk_widget_destroy (child->button);
+      if (child->app != NULL)
+        g_signal_handlers_disconnect_by_func (child->app, xfce_tasklist_button_app_name_changed, child);
 
-          break;
-        }
+      /* destroy the button, this will free the child data in the
+       * container remove function */
+      gtk_widget_destroy (child->button);
     }
 
   gtk_widget_queue_resize (GTK_WIDGET (tasklist));
@@ -2104,6 +2321,10 @@ xfce_tasklist_sort (XfceTasklist *tasklist,
 {
   panel_return_if_fail (XFCE_IS_TASKLIST (tasklist));
 
+  /* new windows are being added, the list is sorted afterwards */
+  if (tasklist->sort_deferred)
+    return;
+
   if (tasklist->sort_order != XFCE_TASKLIST_SORT_ORDER_DND)
     {
       tasklist->windows = g_list_sort_with_data (tasklist->windows,
@@ -2124,6 +2345,126 @@ xfce_tasklist_sort (XfceTasklist *tasklist,
 
 
 
+static gchar *
+xfce_tasklist_sort_key_new (const gchar *name)
+{
+  gchar *casefold, *key;
+
+  if (name == NULL)
+    name = "";
+
+  casefold = g_utf8_casefold (name, -1);
+  key = g_utf8_collate_key (casefold, -1);
+  g_free (casefold);
+
+  return key;
+}
+
+
+
+static void
+xfce_tasklist_child_update_sort_keys (XfceTasklistChild *child)
+{
+  const gchar *app_name = NULL;
+  const gchar *window_name = NULL;
+
+  if (child->window != NULL)
+    window_name = xfw_window_get_name (child->window);
+  if (child->app != NULL)
+    app_name = xfce_tasklist_app_get_name (child->app);
+
+  /* group by app name, fall back to the window name */
+  g_free (child->group_key);
+  child->group_key = xfce_tasklist_sort_key_new (xfce_str_is_empty (app_name) ? window_name : app_name);
+
+  /* sort by window name, fall back to the app name */
+  g_free (child->title_key);
+  child->title_key = xfce_tasklist_sort_key_new (child->window != NULL ? window_name : app_name);
+}
+
+
+
+static gboolean
+xfce_tasklist_child_in_order (gconstpointer prev,
+                              gconstpointer child,
+                              gconstpointer next,
+                              XfceTasklist *tasklist)
+{
+  return (prev == NULL || xfce_tasklist_button_compare (prev, child, tasklist) <= 0)
+         && (next == NULL || xfce_tasklist_button_compare (child, next, tasklist) <= 0);
+}
+
+
+
+static void
+xfce_tasklist_child_reposition (XfceTasklistChild *child)
+{
+  XfceTasklist *tasklist = child->tasklist;
+  GList *li;
+
+  panel_return_if_fail (XFCE_IS_TASKLIST (tasklist));
+
+  if (tasklist->sort_order == XFCE_TASKLIST_SORT_ORDER_DND
+      || tasklist->sort_deferred)
+    return;
+
+  li = g_list_find (tasklist->windows, child);
+  if (li == NULL
+      || xfce_tasklist_child_in_order (li->prev != NULL ? li->prev->data : NULL, child,
+                                       li->next != NULL ? li->next->data : NULL, tasklist))
+    return;
+
+  /* only this button moved, insert it again instead of sorting the list */
+  tasklist->windows = g_list_delete_link (tasklist->windows, li);
+  tasklist->windows = g_list_insert_sorted_with_data (tasklist->windows, child,
+                                                      xfce_tasklist_button_compare,
+                                                      tasklist);
+
+  gtk_widget_queue_resize (GTK_WIDGET (tasklist));
+}
+
+
+
+static void
+xfce_tasklist_queue_update_icon_geometries (XfceTasklist *tasklist)
+{
+  gint64 elapsed;
+
+  if (tasklist->update_icon_geometries_id != 0)
+    return;
+
+  /* when the panel is reallocated on every frame (an animated resize)
+   * publish the geometries at most once per interval, the last
+   * allocation is always published */
+  elapsed = (g_get_monotonic_time () - tasklist->update_icon_geometries_time) / 1000;
+  if (elapsed >= ICON_GEOMETRIES_INTERVAL)
+    tasklist->update_icon_geometries_id = g_idle_add_full (G_PRIORITY_LOW, xfce_tasklist_update_icon_geometries,
+                                                           tasklist, xfce_tasklist_update_icon_geometries_destroyed);
+  else
+    tasklist->update_icon_geometries_id = g_timeout_add_full (G_PRIORITY_LOW, ICON_GEOMETRIES_INTERVAL - elapsed,
+                                                              xfce_tasklist_update_icon_geometries,
+                                                              tasklist, xfce_tasklist_update_icon_geometries_destroyed);
+}
+
+
+
+static void
+xfce_tasklist_child_set_icon_geometry (XfceTasklistChild *child,
+                                       GdkWindow *window,
+                                       GdkRectangle *alloc)
+{
+  /* every update is a property change on the window, skip unchanged ones */
+  if (child->icon_geometry_window == window
+      && gdk_rectangle_equal (&child->icon_geometry, alloc))
+    return;
+
+  child->icon_geometry_window = window;
+  child->icon_geometry = *alloc;
+  xfw_window_set_button_geometry (child->window, window, alloc, NULL);
+}
+
+
+
 static gboolean
 xfce_tasklist_update_icon_geometries (gpointer data)
 {
@@ -2137,6 +2478,8 @@ xfce_tasklist_update_icon_geometries (gpointer data)
   gtk_window_get_position (GTK_WINDOW (toplevel), &root_x, &root_y);
   panel_return_val_if_fail (XFCE_IS_TASKLIST (tasklist), G_SOURCE_REMOVE);
 
+  tasklist->update_icon_geometries_time = g_get_monotonic_time ();
+
   for (li = tasklist->windows; li != NULL; li = li->next)
     {
       XfceTasklistChild *child, *child2;
@@ -2152,7 +2495,7 @@ xfce_tasklist_update_icon_geometries (gpointer data)
           gtk_widget_get_allocation (child->button, &alloc);
           alloc.x += root_x;
           alloc.y += root_y;
-          xfw_window_set_button_geometry (child->window, window, &alloc, NULL);
+          xfce_tasklist_child_set_icon_geometry (child, window, &alloc);
           break;
 
         case CHILD_TYPE_GROUP:
@@ -2163,7 +2506,7 @@ xfce_tasklist_update_icon_geometries (gpointer data)
           for (lp = child->windows; lp != NULL; lp = lp->next)
             {
               child2 = lp->data;
-              xfw_window_set_button_geometry (child2->window, window, &alloc, NULL);
+              xfce_tasklist_child_set_icon_geometry (child2, window, &alloc);
             }
           break;
 
@@ -2172,7 +2515,7 @@ xfce_tasklist_update_icon_geometries (gpointer data)
           gtk_widget_get_allocation (tasklist->arrow_button, &alloc);
           alloc.x += root_x;
           alloc.y += root_y;
-          xfw_window_set_button_geometry (child->window, window, &alloc, NULL);
+          xfce_tasklist_child_set_icon_geometry (child, window, &alloc);
           break;
 
         case CHILD_TYPE_GROUP_MENU:
@@ -2667,10 +3010,8 @@ xfce_tasklist_button_compare (gconstpointer child_a,
 {
   const XfceTasklistChild *a = child_a, *b = child_b;
   XfceTasklist *tasklist = XFCE_TASKLIST (user_data);
-  gint retval;
-  XfwApplication *app_a, *app_b;
-  const gchar *name_a, *name_b;
   XfwWorkspace *workspace_a, *workspace_b;
+  gint retval;
   gint num_a = -1, num_b = -1;
 
   panel_return_val_if_fail (a->type == CHILD_TYPE_GROUP || XFW_IS_WINDOW (a->window), 0);
@@ -2680,67 +3021,37 @@ xfce_tasklist_button_compare (gconstpointer child_a,
   if (tasklist->sort_order == XFCE_TASKLIST_SORT_ORDER_DND)
     return a->unique_id - b->unique_id;
 
-  if (tasklist->all_workspaces)
+  /* skip this if windows are in same worspace, or both pinned (== NULL),
+   * the workspace is the one of the button's bucket */
+  if (tasklist->all_workspaces
+      && a->workspace != b->workspace)
     {
-      /* get workspace (this is slightly inefficient because the XfwWindow
-       * also stores the workspace number, not the structure, and we use that
-       * for comparing too */
-      workspace_a = a->window != NULL ? xfw_window_get_workspace (a->window) : NULL;
-      workspace_b = b->window != NULL ? xfw_window_get_workspace (b->window) : NULL;
-
-      /* skip this if windows are in same worspace, or both pinned (== NULL) */
-      if (workspace_a != workspace_b)
-        {
-          /* NULL means the window is pinned */
-          if (workspace_a == NULL)
-            workspace_a = xfw_workspace_group_get_active_workspace (tasklist->workspace_group);
-          if (workspace_b == NULL)
-            workspace_b = xfw_workspace_group_get_active_workspace (tasklist->workspace_group);
-
-          /* compare by workspace number */
-          if (workspace_a != NULL)
-            num_a = xfw_workspace_get_number (workspace_a);
-          if (workspace_b != NULL)
-            num_b = xfw_workspace_get_number (workspace_b);
-
-          if (num_a != num_b)
-            return num_a - num_b;
-        }
+      workspace_a = a->workspace;
+      workspace_b = b->workspace;
+
+      /* NULL means the window is pinned */
+      if (workspace_a == NULL)
+        workspace_a = xfw_workspace_group_get_active_workspace (tasklist->workspace_group);
+      if (workspace_b == NULL)
+        workspace_b = xfw_workspace_group_get_active_workspace (tasklist->workspace_group);
+
+      /* compare by workspace number */
+      if (workspace_a != NULL)
+        num_a = xfw_workspace_get_number (workspace_a);
+      if (workspace_b != NULL)
+        num_b = xfw_workspace_get_number (workspace_b);
+
+      if (num_a != num_b)
+        return num_a - num_b;
     }
 
   if (tasklist->sort_order == XFCE_TASKLIST_SORT_ORDER_GROUP_TITLE
       || tasklist->sort_order == XFCE_TASKLIST_SORT_ORDER_GROUP_TIMESTAMP)
     {
-      /* compare by app names */
-      app_a = a->app;
-      app_b = b->app;
-
       /* skip this if windows are in same group (or both NULL) */
-      if (app_a != app_b)
+      if (a->app != b->app)
         {
-          name_a = NULL;
-          name_b = NULL;
-
-          /* get the group name if available */
-          if (G_LIKELY (app_a != NULL))
-            name_a = xfce_tasklist_app_get_name (app_a);
-          if (G_LIKELY (app_b != NULL))
-            name_b = xfce_tasklist_app_get_name (app_b);
-
-          /* if there is no app name, use the window name */
-          if (xfce_str_is_empty (name_a)
-              && a->window != NULL)
-            name_a = xfw_window_get_name (a->window);
-          if (xfce_str_is_empty (name_b)
-              && b->window != NULL)
-            name_b = xfw_window_get_name (b->window);
-
-          if (name_a == NULL)
-            name_a = "";
-          if (name_b == NULL)
-            name_b = "";
-
-          retval = strcasecmp (name_a, name_b);
+          retval = strcmp (a->group_key, b->group_key);
           if (retval != 0)
             return retval;
         }
@@ -2754,32 +3065,14 @@ xfce_tasklist_button_compare (gconstpointer child_a,
 
   if (tasklist->sort_order == XFCE_TASKLIST_SORT_ORDER_TIMESTAMP
       || tasklist->sort_order == XFCE_TASKLIST_SORT_ORDER_GROUP_TIMESTAMP)
-    {
-      return a->unique_id - b->unique_id;
-    }
-  else
-    {
-      if (a->window != NULL)
-        name_a = xfw_window_get_name (a->window);
-      else if (a->app != NULL)
-        name_a = xfce_tasklist_app_get_name (a->app);
-      else
-        name_a = NULL;
-
-      if (b->window != NULL)
-        name_b = xfw_window_get_name (b->window);
-      else if (b->app != NULL)
-        name_b = xfce_tasklist_app_get_name (b->app);
-      else
-        name_b = NULL;
+    return a->unique_id - b->unique_id;
 
-      if (name_a == NULL)
-        name_a = "";
-      if (name_b == NULL)
-        name_b = "";
+  /* equal titles stay in the order the windows were created */
+  retval = strcmp (a->title_key, b->title_key);
+  if (retval == 0)
+    retval = a->unique_id - b->unique_id;
 
-      return strcasecmp (name_a, name_b);
-    }
+  return retval;
 }
 
 
@@ -2875,7 +3168,7 @@ xfce_tasklist_button_icon_changed (XfwWindow *window,
     }
 
   child->pixbuf = g_object_ref (pixbuf);
-  surface = gdk_cairo_surface_create_from_pixbuf (pixbuf, scale_factor, NULL);
+  surface = panel_icon_cache_lookup (pixbuf, 0, scale_factor, 100);
   gtk_image_set_from_surface (GTK_IMAGE (child->icon), surface);
   cairo_surface_destroy (surface);
 
@@ -2927,8 +3220,9 @@ xfce_tasklist_button_name_changed (XfwWindow *window,
 
   /* if window is null, we have not inserted the button the in
    * tasklist, so no need to sort, because we insert with sorting */
+  xfce_tasklist_child_update_sort_keys (child);
   if (window != NULL)
-    xfce_tasklist_sort (child->tasklist, FALSE);
+    xfce_tasklist_child_reposition (child);
 }
 
 
@@ -3051,10 +3345,21 @@ xfce_tasklist_button_workspace_changed (XfwWindow *window,
   panel_return_if_fail (child->window == window);
   panel_return_if_fail (XFCE_IS_TASKLIST (child->tasklist));
 
-  xfce_tasklist_sort (tasklist, FALSE);
+  /* move the button to its new workspace bucket */
+  xfce_tasklist_workspace_index_remove (tasklist, child);
+  xfce_tasklist_workspace_index_add (tasklist, child);
+
+  xfce_tasklist_child_reposition (child);
   xfce_tasklist_active_window_changed (tasklist->screen, window, tasklist);
-  if (!tasklist->all_workspaces)
-    xfce_tasklist_active_workspace_changed (tasklist->workspace_group, NULL, tasklist);
+
+  /* only the visibility of this button can change */
+  if (!tasklist->all_workspaces && !xfce_taskbar_is_locked (tasklist))
+    {
+      if (xfce_tasklist_button_visible (child, xfw_workspace_group_get_active_workspace (tasklist->workspace_group)))
+        gtk_widget_show (child->button);
+      else
+        gtk_widget_hide (child->button);
+    }
 }
 
 
@@ -3083,6 +3388,21 @@ xfce_tasklist_button_monitors_changed (XfwWindow *window,
 
 
 
+static void
+xfce_tasklist_button_app_name_changed (XfwApplication *app,
+                                       GParamSpec *pspec,
+                                       XfceTasklistChild *child)
+{
+  panel_return_if_fail (child->app == app);
+  panel_return_if_fail (XFCE_IS_TASKLIST (child->tasklist));
+
+  /* the group key derives from the app name, also without grouping */
+  xfce_tasklist_child_update_sort_keys (child);
+  xfce_tasklist_child_reposition (child);
+}
+
+
+
 static void
 xfce_tasklist_button_application_changed (XfwWindow *window,
                                           GParamSpec *pspec,
@@ -3095,7 +3415,15 @@ xfce_tasklist_button_application_changed (XfwWindow *window,
   panel_return_if_fail (XFW_IS_SCREEN (child->tasklist->screen));
 
   old_app = child->app;
+  if (old_app != NULL)
+    g_signal_handlers_disconnect_by_func (old_app, xfce_tasklist_button_app_name_changed, child);
+
   child->app = xfw_window_get_application (window);
+  if (child->app != NULL)
+    g_signal_connect (G_OBJECT (child->app), "notify::name",
+                      G_CALLBACK (xfce_tasklist_button_app_name_changed), child);
+  xfce_tasklist_child_update_sort_keys (child);
+  xfce_tasklist_child_reposition (child);
   if (child->tasklist->grouping)
     {
       XfceTasklistChild *old_group_child = g_hash_table_lookup (child->tasklist->apps, old_app);
@@ -3816,14 +4144,27 @@ xfce_tasklist_button_new (XfwWindow *window,
   g_signal_connect (G_OBJECT (window), "notify::application",
                     G_CALLBACK (xfce_tasklist_button_application_changed), child);
 
+  /* the sort keys derive from the app name too */
+  if (child->app != NULL)
+    g_signal_connect (G_OBJECT (child->app), "notify::name",
+                      G_CALLBACK (xfce_tasklist_button_app_name_changed), child);
+
   /* poke functions */
   xfce_tasklist_button_icon_changed (window, child);
   xfce_tasklist_button_name_changed (NULL, child);
 
-  /* insert */
-  tasklist->windows = g_list_insert_sorted_with_data (tasklist->windows, child,
-                                                      xfce_tasklist_button_compare,
-                                                      tasklist);
+  /* insert, the index sets the workspace used for sorting */
+  xfce_tasklist_window_index_add (tasklist, child);
+  if (!tasklist->sort_deferred)
+    tasklist->windows = g_list_insert_sorted_with_data (tasklist->windows, child,
+                                                        xfce_tasklist_button_compare,
+                                                        tasklist);
+  else if (tasklist->sort_order != XFCE_TASKLIST_SORT_ORDER_DND)
+    /* the list is sorted once the batch is added */
+    tasklist->windows = g_list_prepend (tasklist->windows, child);
+  else
+    /* nothing sorts the list afterwards in dnd mode */
+    tasklist->windows = g_list_append (tasklist->windows, child);
 
   return child;
 }
@@ -4323,6 +4664,9 @@ xfce_tasklist_group_button_name_changed (XfwApplication *app,
   name = xfce_tasklist_app_get_name (group_child->app);
   gtk_label_set_text (GTK_LABEL (group_child->label), name);
 
+  /* the window buttons update their own keys on a name change */
+  xfce_tasklist_child_update_sort_keys (group_child);
+
   /* don't sort if there is no need to update the sorting (ie. only number
    * of windows is changed or button is not inserted in the tasklist yet */
   if (app != NULL)
@@ -4411,7 +4755,7 @@ xfce_tasklist_group_button_icon_changed (XfwApplication *app,
         }
 
       group_child->pixbuf = g_object_ref (pixbuf);
-      surface = gdk_cairo_surface_create_from_pixbuf (pixbuf, scale_factor, NULL);
+      surface = panel_icon_cache_lookup (pixbuf, 0, scale_factor, 100);
       gtk_image_set_from_surface (GTK_IMAGE (group_child->icon), surface);
       cairo_surface_destroy (surface);
 
@@ -4609,6 +4953,38 @@ xfce_tasklist_group_button_sort (XfceTasklistChild *group_child)
 
 
 
+static void
+xfce_tasklist_group_button_window_changed (XfwWindow *window,
+                                           XfceTasklistChild *group_child)
+{
+  XfceTasklistChild *window_child;
+  GSList *li, *prev = NULL;
+
+  panel_return_if_fail (group_child->type == CHILD_TYPE_GROUP);
+
+  if (group_child->tasklist->sort_order == XFCE_TASKLIST_SORT_ORDER_DND)
+    return;
+
+  /* the window button refreshed its keys in its own handler */
+  window_child = g_hash_table_lookup (group_child->tasklist->window_children, window);
+  for (li = group_child->windows; li != NULL; prev = li, li = li->next)
+    if (li->data == window_child)
+      break;
+
+  if (li == NULL
+      || xfce_tasklist_child_in_order (prev != NULL ? prev->data : NULL, window_child,
+                                       li->next != NULL ? li->next->data : NULL,
+                                       group_child->tasklist))
+    return;
+
+  group_child->windows = g_slist_delete_link (group_child->windows, li);
+  group_child->windows = g_slist_insert_sorted_with_data (group_child->windows, window_child,
+                                                          xfce_tasklist_button_compare,
+                                                          group_child->tasklist);
+}
+
+
+
 static void
 xfce_tasklist_group_button_add_window (XfceTasklistChild *group_child,
                                        XfceTasklistChild *window_child)
@@ -4626,10 +5002,10 @@ xfce_tasklist_group_button_add_window (XfceTasklistChild *group_child,
                             G_CALLBACK (xfce_tasklist_group_button_child_visible_changed), group_child);
   g_signal_connect_swapped (G_OBJECT (window_child->button), "destroy",
                             G_CALLBACK (xfce_tasklist_group_button_child_destroyed), group_child);
-  g_signal_connect_swapped (G_OBJECT (window_child->window), "name-changed",
-                            G_CALLBACK (xfce_tasklist_group_button_sort), group_child);
-  g_signal_connect_swapped (G_OBJECT (window_child->window), "workspace-changed",
-                            G_CALLBACK (xfce_tasklist_group_button_sort), group_child);
+  g_signal_connect (G_OBJECT (window_child->window), "name-changed",
+                    G_CALLBACK (xfce_tasklist_group_button_window_changed), group_child);
+  g_signal_connect (G_OBJECT (window_child->window), "workspace-changed",
+                    G_CALLBACK (xfce_tasklist_group_button_window_changed), group_child);
 
   /* add to internal list */
   group_child->windows = g_slist_insert_sorted_with_data (group_child->windows, window_child,
@@ -4676,10 +5052,13 @@ xfce_tasklist_group_button_new (XfwApplication *app,
   xfce_tasklist_group_button_icon_changed (app, child);
   xfce_tasklist_group_button_name_changed (NULL, NULL, child);
 
-  /* insert */
-  tasklist->windows = g_list_insert_sorted_with_data (tasklist->windows, child,
-                                                      xfce_tasklist_button_compare,
-                                                      tasklist);
+  /* insert, the list is sorted once a batch of windows is added */
+  if (tasklist->sort_deferred && tasklist->sort_order != XFCE_TASKLIST_SORT_ORDER_DND)
+    tasklist->windows = g_list_prepend (tasklist->windows, child);
+  else
+    tasklist->windows = g_list_insert_sorted_with_data (tasklist->windows, child,
+                                                        xfce_tasklist_button_compare,
+                                                        tasklist);
 
   return child;
 }
@@ -18,6 +18,7 @@
 
 #include "windowmenu.h"
 
+#include "common/panel-icon-cache.h"
 #include "common/panel-private.h"
 #include "common/panel-utils.h"
 #include "common/panel-xfconf.h"
@@ -738,7 +739,7 @@ window_menu_plugin_set_icon (WindowMenuPlugin *plugin,
 
   if (G_LIKELY (pixbuf != NULL))
     {
-      cairo_surface_t *surface = gdk_cairo_surface_create_from_pixbuf (pixbuf, scale_factor, NULL);
+      cairo_surface_t *surface = panel_icon_cache_lookup (pixbuf, 0, scale_factor, 100);
       gtk_image_set_from_surface (GTK_IMAGE (plugin->widget), surface);
       cairo_surface_destroy (surface);
     }
@@ -1115,7 +1116,7 @@ window_menu_plugin_menu_window_item_new (XfwWindow *window,
   gchar *utf8 = NULL;
   gchar *decorated = NULL;
   GtkWidget *mi, *label, *image;
-  GdkPixbuf *pixbuf, *lucent = NULL, *scaled = NULL;
+  GdkPixbuf *pixbuf;
   gint scale_factor;
 
   panel_return_val_if_fail (XFW_IS_WINDOW (window), NULL);
@@ -1170,40 +1171,22 @@ window_menu_plugin_menu_window_item_new (XfwWindow *window,
       /* get the window icon */
       scale_factor = gtk_widget_get_scale_factor (GTK_WIDGET (plugin));
       pixbuf = xfw_window_get_icon (window, size, scale_factor);
-      size *= scale_factor;
       if (pixbuf != NULL)
         {
           cairo_surface_t *surface;
 
-          /* scale the icon if needed */
-          if (gdk_pixbuf_get_width (pixbuf) > size
-              || gdk_pixbuf_get_height (pixbuf) > size)
-            {
-              scaled = gdk_pixbuf_scale_simple (pixbuf, size, size, GDK_INTERP_BILINEAR);
-              if (G_LIKELY (scaled != NULL))
-                pixbuf = scaled;
-            }
-
-          /* dimm the icon if the window is minimized */
-          if (xfw_window_is_minimized (window)
-              && plugin->minimized_icon_lucency < 100)
-            {
-              lucent = xfce_gdk_pixbuf_lucent (pixbuf, plugin->minimized_icon_lucency);
-              if (G_LIKELY (lucent != NULL))
-                pixbuf = lucent;
-            }
+          /* scaled and dimmed (if the window is minimized) icon, shared
+           * with the other windows of the same application */
+          surface = panel_icon_cache_lookup (pixbuf, size * scale_factor, scale_factor,
+                                             xfw_window_is_minimized (window)
+                                               ? plugin->minimized_icon_lucency
+                                               : 100);
 
           /* set the menu item label */
-          surface = gdk_cairo_surface_create_from_pixbuf (pixbuf, scale_factor, NULL);
           image = gtk_image_new_from_surface (surface);
           cairo_surface_destroy (surface);
           panel_image_menu_item_set_image (mi, image);
           gtk_widget_show (image);
-
-          if (lucent != NULL)
-            g_object_unref (G_OBJECT (lucent));
-          if (scaled != NULL)
-            g_object_unref (G_OBJECT (scaled));
         }
     }
 
@@ -21,21 +21,47 @@
 #include "wrapper-plug.h"
 
 #include "common/panel-dbus.h"
+#include "common/panel-host.h"
 #include "common/panel-private.h"
+#include "common/panel-ring.h"
 #include "libxfce4panel/libxfce4panel.h"
 #include "libxfce4panel/xfce-panel-plugin-provider.h"
 
+#include <errno.h>
+#include <fcntl.h>
 #include <gio/gio.h>
+#include <glib-unix.h>
 #include <gtk/gtk.h>
 #include <libxfce4util/libxfce4util.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
 
 
 
-static gint retval = PLUGIN_EXIT_FAILURE;
+typedef struct _WrapperPlugin
+{
+  gint unique_id;
+  GDBusProxy *proxy;
+  GtkWidget *plug;
+  GtkWidget *provider;
+
+  gint retval;
+  guint ring_source_id;
+  guint finished : 1;
+} WrapperPlugin;
+
+
+
+static PanelRing *ring = NULL;
 #ifndef ENABLE_X11
 typedef gulong Window;
 #endif
 
+/* host mode: the socket to the panel and the plugins by unique id */
+static gint host_socket = -1;
+static GHashTable *host_plugins = NULL;
+
 
 
 static void
@@ -57,12 +83,104 @@ wrapper_gproxy_name_owner_changed (GDBusProxy *proxy,
 
 
 static void
-wrapper_gproxy_set (GDBusProxy *proxy,
-                    gchar *sender_name,
-                    gchar *signal_name,
-                    GVariant *parameters,
-                    XfcePanelPluginProvider *provider)
+wrapper_plugin_free (gpointer data)
+{
+  WrapperPlugin *plugin = data;
+
+  if (plugin->ring_source_id != 0)
+    g_source_remove (plugin->ring_source_id);
+
+  if (plugin->proxy != NULL)
+    {
+      g_signal_handlers_disconnect_by_data (plugin->proxy, plugin);
+      g_object_unref (plugin->proxy);
+    }
+
+  /* destroy the plug and provider */
+  if (plugin->plug != NULL)
+    {
+      g_object_remove_weak_pointer (G_OBJECT (plugin->plug), (gpointer *) &plugin->plug);
+      gtk_widget_destroy (plugin->plug);
+    }
+
+  if (plugin->provider != NULL)
+    {
+      g_object_remove_weak_pointer (G_OBJECT (plugin->provider), (gpointer *) &plugin->provider);
+      gtk_widget_destroy (plugin->provider);
+    }
+
+  g_slice_free (WrapperPlugin, plugin);
+}
+
+
+
+static gint
+wrapper_plugin_get_exit_code (WrapperPlugin *plugin)
+{
+  if (plugin->retval == PLUGIN_EXIT_SUCCESS_AND_RESTART)
+    return plugin->retval;
+
+  return plugin->plug == NULL || GPOINTER_TO_INT (g_object_get_data (G_OBJECT (plugin->plug), "exit-code"));
+}
+
+
+
+static void
+wrapper_host_reply (gint unique_id,
+                    gint status)
+{
+  PanelHostReply reply = { unique_id, status };
+
+  while (send (host_socket, &reply, sizeof (reply), MSG_NOSIGNAL) == -1
+         && errno == EINTR)
+    ;
+}
+
+
+
+static gboolean
+wrapper_host_remove_plugin (gpointer data)
 {
+  WrapperPlugin *plugin = data;
+
+  g_hash_table_remove (host_plugins, GINT_TO_POINTER (plugin->unique_id));
+
+  return FALSE;
+}
+
+
+
+static void
+wrapper_plugin_finish (WrapperPlugin *plugin,
+                       gint status)
+{
+  if (plugin->finished)
+    return;
+
+  plugin->finished = TRUE;
+
+  if (host_socket == -1)
+    {
+      /* do not call gtk_main_quit() twice */
+      g_signal_handlers_disconnect_by_func (plugin->proxy, wrapper_gproxy_name_owner_changed, NULL);
+      gtk_main_quit ();
+    }
+  else
+    {
+      /* only this plugin leaves the host, the panel handles the status
+       * like the exit of a wrapper process */
+      wrapper_host_reply (plugin->unique_id, status);
+      g_idle_add (wrapper_host_remove_plugin, plugin);
+    }
+}
+
+
+
+static void
+wrapper_set_properties (WrapperPlugin *plugin,
+                        GVariant *parameters)
+{
+  XfcePanelPluginProvider *provider = XFCE_PANEL_PLUGIN_PROVIDER (plugin->provider);
   GtkWidget *plug;
   GVariantIter iter;
   GVariant *variant;
@@ -74,7 +192,7 @@ wrapper_gproxy_set (GDBusProxy *proxy,
 
   g_variant_iter_init (&iter, parameters);
 
-  while (g_variant_iter_next (&iter, "(uv)", &type, &variant))
+  while (!plugin->finished && g_variant_iter_next (&iter, "(uv)", &type, &variant))
     {
       switch (type)
         {
@@ -148,12 +266,10 @@ wrapper_gproxy_set (GDBusProxy *proxy,
           break;
 
         case PROVIDER_PROP_TYPE_ACTION_QUIT_FOR_RESTART:
-          retval = PLUGIN_EXIT_SUCCESS_AND_RESTART;
+          plugin->retval = PLUGIN_EXIT_SUCCESS_AND_RESTART;
           /* fall through */
         case PROVIDER_PROP_TYPE_ACTION_QUIT:
-          /* do not call gtk_main_quit() twice */
-          g_signal_handlers_disconnect_by_func (proxy, wrapper_gproxy_name_owner_changed, NULL);
-          gtk_main_quit ();
+          wrapper_plugin_finish (plugin, W_EXITCODE (wrapper_plugin_get_exit_code (plugin), 0));
           break;
 
         case PROVIDER_PROP_TYPE_ACTION_SHOW_CONFIGURE:
@@ -185,13 +301,86 @@ wrapper_gproxy_set (GDBusProxy *proxy,
 
 
 
+static void
+wrapper_ring_drain (WrapperPlugin *plugin)
+{
+  GVariant *parameters;
+
+  if (ring == NULL)
+    return;
+
+  while ((parameters = panel_ring_pop (ring)) != NULL)
+    {
+      wrapper_set_properties (plugin, parameters);
+      g_variant_unref (parameters);
+    }
+}
+
+
+
+static gboolean
+wrapper_ring_event (gint fd,
+                    GIOCondition condition,
+                    gpointer data)
+{
+  panel_ring_acknowledge (ring);
+  wrapper_ring_drain (data);
+
+  return G_SOURCE_CONTINUE;
+}
+
+
+
+static void
+wrapper_ring_attach (void)
+{
+  const gchar *value;
+  gint shm_fd, event_fd;
+  GError *error = NULL;
+
+  /* the panel passes the ring when it could create one */
+  value = g_getenv (PANEL_RING_ENVIRONMENT);
+  if (value == NULL)
+    return;
+
+  if (sscanf (value, "%d,%d", &shm_fd, &event_fd) == 2)
+    {
+      ring = panel_ring_new_from_fds (shm_fd, event_fd, &error);
+      if (G_UNLIKELY (ring == NULL))
+        {
+          g_warning ("Failed to attach to the property ring: %s", error->message);
+          g_error_free (error);
+        }
+    }
+
+  /* do not leak the variable into processes spawned by the plugin */
+  g_unsetenv (PANEL_RING_ENVIRONMENT);
+}
+
+
+
+static void
+wrapper_gproxy_set (GDBusProxy *proxy,
+                    gchar *sender_name,
+                    gchar *signal_name,
+                    GVariant *parameters,
+                    WrapperPlugin *plugin)
+{
+  /* handle properties the panel wrote to the ring before this signal */
+  wrapper_ring_drain (plugin);
+  wrapper_set_properties (plugin, parameters);
+}
+
+
+
 static void
 wrapper_gproxy_remote_event (GDBusProxy *proxy,
                              gchar *sender_name,
                              gchar *signal_name,
                              GVariant *parameters,
-                             XfcePanelPluginProvider *provider)
+                             WrapperPlugin *plugin)
 {
+  XfcePanelPluginProvider *provider = XFCE_PANEL_PLUGIN_PROVIDER (plugin->provider);
   WrapperPlug *plug;
   GVariant *variant;
   guint handle;
@@ -201,6 +390,11 @@ wrapper_gproxy_remote_event (GDBusProxy *proxy,
 
   panel_return_if_fail (XFCE_IS_PANEL_PLUGIN_PROVIDER (provider));
 
+  /* the event may depend on properties still pending in the ring */
+  wrapper_ring_drain (plugin);
+  if (plugin->finished)
+    return;
+
   if (G_LIKELY (g_variant_is_of_type (parameters, G_VARIANT_TYPE ("(svu)"))))
     {
       g_variant_get (parameters, "(&svu)", &name, &variant, &handle);
@@ -229,6 +423,248 @@ wrapper_gproxy_remote_event (GDBusProxy *proxy,
 
 
 
+static WrapperPlugin *
+wrapper_plugin_new (WrapperModule *module,
+                    gint unique_id,
+                    Window socket_id,
+                    const gchar *name,
+                    const gchar *display_name,
+                    const gchar *comment,
+                    gchar **arguments,
+                    gint *exit_code,
+                    GError **error)
+{
+  WrapperPlugin *plugin;
+  GDBusConnection *dbus_gconnection;
+  gchar *path;
+
+  plugin = g_slice_new0 (WrapperPlugin);
+  plugin->unique_id = unique_id;
+  plugin->retval = PLUGIN_EXIT_FAILURE;
+  *exit_code = PLUGIN_EXIT_FAILURE;
+
+  /* connect the dbus proxy */
+  dbus_gconnection = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, error);
+  if (G_UNLIKELY (dbus_gconnection == NULL))
+    goto failed;
+
+  path = g_strdup_printf (PANEL_DBUS_WRAPPER_PATH, unique_id);
+  plugin->proxy = g_dbus_proxy_new_sync (dbus_gconnection,
+                                         G_DBUS_PROXY_FLAGS_NONE,
+                                         NULL,
+                                         PANEL_DBUS_NAME,
+                                         path,
+                                         PANEL_DBUS_WRAPPER_INTERFACE,
+                                         NULL,
+                                         error);
+  g_free (path);
+  g_object_unref (dbus_gconnection);
+  if (G_UNLIKELY (plugin->proxy == NULL))
+    goto failed;
+
+  /* quit when the proxy is destroyed (panel segfault for example) */
+  g_signal_connect (G_OBJECT (plugin->proxy), "notify::g-name-owner",
+                    G_CALLBACK (wrapper_gproxy_name_owner_changed), NULL);
+
+  /* create the plugin provider */
+  plugin->provider = wrapper_module_new_provider (module,
+                                                  gdk_screen_get_default (),
+                                                  name, unique_id,
+                                                  display_name, comment,
+                                                  arguments);
+  if (G_UNLIKELY (plugin->provider == NULL))
+    {
+      *exit_code = PLUGIN_EXIT_NO_PROVIDER;
+      goto failed;
+    }
+
+  g_object_add_weak_pointer (G_OBJECT (plugin->provider), (gpointer *) &plugin->provider);
+
+  /* create the wrapper plug */
+  plugin->plug = wrapper_plug_new (socket_id, unique_id, plugin->proxy, error);
+  if (plugin->plug == NULL)
+    goto failed;
+
+  gtk_container_add (GTK_CONTAINER (plugin->plug), GTK_WIDGET (plugin->provider));
+  g_object_add_weak_pointer (G_OBJECT (plugin->plug), (gpointer *) &plugin->plug);
+  gtk_widget_show (plugin->plug);
+
+  /* monitor provider signals */
+  g_signal_connect_swapped (G_OBJECT (plugin->provider), "provider-signal",
+                            G_CALLBACK (wrapper_plug_proxy_provider_signal), plugin->plug);
+
+  /* connect to service signals */
+  g_signal_connect (plugin->proxy, "g-signal::Set",
+                    G_CALLBACK (wrapper_gproxy_set), plugin);
+  g_signal_connect (plugin->proxy, "g-signal::RemoteEvent",
+                    G_CALLBACK (wrapper_gproxy_remote_event), plugin);
+
+  /* receive properties through the shared memory ring */
+  if (ring != NULL)
+    plugin->ring_source_id = g_unix_fd_add (panel_ring_get_event_fd (ring), G_IO_IN,
+                                            wrapper_ring_event, plugin);
+
+  /* show the plugin */
+  gtk_widget_show (GTK_WIDGET (plugin->provider));
+
+  return plugin;
+
+failed:
+  wrapper_plugin_free (plugin);
+
+  return NULL;
+}
+
+
+
+static void
+wrapper_host_add_plugin (gint unique_id,
+                         gchar **argv)
+{
+  gpointer preinit_func;
+  WrapperModule *module;
+  WrapperPlugin *plugin;
+  GError *error = NULL;
+  gint exit_code = PLUGIN_EXIT_ARGUMENTS_FAILED;
+  gint argc = g_strv_length (argv);
+
+  if (G_UNLIKELY (argc < PLUGIN_ARGV_ARGUMENTS
+                  || g_hash_table_contains (host_plugins, GINT_TO_POINTER (unique_id))))
+    {
+      g_critical ("Invalid request to host plugin %d", unique_id);
+      wrapper_host_reply (unique_id, W_EXITCODE (exit_code, 0));
+      return;
+    }
+
+  module = wrapper_module_new_shared (argv[PLUGIN_ARGV_FILENAME], &error);
+  if (G_UNLIKELY (module == NULL))
+    {
+      exit_code = PLUGIN_EXIT_FAILURE;
+      goto failed;
+    }
+
+  /* the preinit function has to run before gtk is initialized, which
+   * already happened here, so let the panel spawn the plugin on its own */
+  if (g_module_symbol (wrapper_module_get_library (module), "xfce_panel_module_preinit", &preinit_func)
+      && preinit_func != NULL)
+    {
+      g_object_unref (module);
+      exit_code = PLUGIN_EXIT_NOT_HOSTABLE;
+      goto failed;
+    }
+
+  plugin = wrapper_plugin_new (module, unique_id,
+                               strtol (argv[PLUGIN_ARGV_SOCKET_ID], NULL, 0),
+                               argv[PLUGIN_ARGV_NAME],
+                               argv[PLUGIN_ARGV_DISPLAY_NAME],
+                               argv[PLUGIN_ARGV_COMMENT],
+                               argv + PLUGIN_ARGV_ARGUMENTS,
+                               &exit_code, &error);
+  g_object_unref (module);
+
+  if (G_UNLIKELY (plugin == NULL))
+    goto failed;
+
+  g_hash_table_insert (host_plugins, GINT_TO_POINTER (unique_id), plugin);
+
+  return;
+
+failed:
+  if (error != NULL)
+    {
+      g_critical ("Wrapper %s-%d: %s.", argv[PLUGIN_ARGV_NAME], unique_id, error->message);
+      g_error_free (error);
+    }
+
+  wrapper_host_reply (unique_id, W_EXITCODE (exit_code, 0));
+}
+
+
+
+static gboolean
+wrapper_host_request (gint fd,
+                      GIOCondition condition,
+                      gpointer data)
+{
+  gchar buffer[PANEL_HOST_MAX_REQUEST];
+  WrapperPlugin *plugin;
+  GVariant *request;
+  const gchar **strv;
+  gchar **argv;
+  guint command;
+  gint unique_id;
+  gint signum;
+  gssize len;
+
+  len = recv (fd, buffer, sizeof (buffer), MSG_DONTWAIT);
+  if (len == -1 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK))
+    return G_SOURCE_CONTINUE;
+
+  /* the panel closed the host */
+  if (len <= 0)
+    {
+      gtk_main_quit ();
+      return G_SOURCE_REMOVE;
+    }
+
+  request = g_variant_ref_sink (g_variant_new_from_data (G_VARIANT_TYPE (PANEL_HOST_REQUEST_TYPE),
+                                                         buffer, len, FALSE, NULL, NULL));
+  g_variant_get (request, "(uiias)", &command, &unique_id, &signum, NULL);
+  g_variant_get_child (request, 3, "^a&s", &strv);
+  argv = g_strdupv ((gchar **) strv);
+  g_free (strv);
+  g_variant_unref (request);
+
+  switch (command)
+    {
+    case PANEL_HOST_REQUEST_ADD:
+      wrapper_host_add_plugin (unique_id, argv);
+      break;
+
+    case PANEL_HOST_REQUEST_REMOVE:
+      plugin = g_hash_table_lookup (host_plugins, GINT_TO_POINTER (unique_id));
+      if (plugin != NULL)
+        wrapper_plugin_finish (plugin, signum);
+      break;
+
+    default:
+      g_critical ("Received unknown host request %u", command);
+      break;
+    }
+
+  g_strfreev (argv);
+
+  return G_SOURCE_CONTINUE;
+}
+
+
+
+static gint
+wrapper_host_run (gint argc,
+                  gchar **argv)
+{
+  host_socket = PANEL_HOST_SOCKET_FD;
+  if (fcntl (host_socket, F_SETFD, FD_CLOEXEC) == -1)
+    {
+      g_critical ("Plugin host started without a socket");
+      return PLUGIN_EXIT_ARGUMENTS_FAILED;
+    }
+
+  gtk_init (&argc, &argv);
+
+  host_plugins = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, wrapper_plugin_free);
+  g_unix_fd_add (host_socket, G_IO_IN | G_IO_HUP | G_IO_ERR, wrapper_host_request, NULL);
+
+  gtk_main ();
+
+  g_hash_table_destroy (host_plugins);
+
+  /* plugins still hosted at this point went away unexpectedly */
+  return PLUGIN_EXIT_FAILURE;
+}
+
+
+
 gint
 main (gint argc,
       gchar **argv)
@@ -238,12 +674,8 @@ main (gint argc,
 #endif
   GModule *library = NULL;
   XfcePanelPluginPreInit preinit_func;
-  GDBusConnection *dbus_gconnection;
-  GDBusProxy *dbus_gproxy = NULL;
   WrapperModule *module = NULL;
-  GtkWidget *plug;
-  GtkWidget *provider = NULL;
-  gchar *path;
+  WrapperPlugin *plugin;
   GError *error = NULL;
   const gchar *filename;
   gint unique_id;
@@ -252,10 +684,15 @@ main (gint argc,
   const gchar *display_name;
   const gchar *comment;
   gchar **arguments;
+  gint retval = PLUGIN_EXIT_FAILURE;
 
   /* set translation domain */
   xfce_textdomain (GETTEXT_PACKAGE, PACKAGE_LOCALE_DIR, "UTF-8");
 
+  /* run several plugins in this process */
+  if (argc == 2 && g_strcmp0 (argv[1], PANEL_HOST_ARGUMENT) == 0)
+    return wrapper_host_run (argc, argv);
+
   /* check if we have all the reuiqred arguments */
   if (G_UNLIKELY (argc < PLUGIN_ARGV_ARGUMENTS))
     {
@@ -300,82 +737,25 @@ main (gint argc,
 
   gtk_init (&argc, &argv);
 
-  /* connect the dbus proxy */
-  dbus_gconnection = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, &error);
-  if (G_UNLIKELY (dbus_gconnection == NULL))
-    goto leave;
-
-  path = g_strdup_printf (PANEL_DBUS_WRAPPER_PATH, unique_id);
-  dbus_gproxy = g_dbus_proxy_new_sync (dbus_gconnection,
-                                       G_DBUS_PROXY_FLAGS_NONE,
-                                       NULL,
-                                       PANEL_DBUS_NAME,
-                                       path,
-                                       PANEL_DBUS_WRAPPER_INTERFACE,
-                                       NULL,
-                                       &error);
-  g_free (path);
-  if (G_UNLIKELY (dbus_gproxy == NULL))
-    goto leave;
-
-  /* quit when the proxy is destroyed (panel segfault for example) */
-  g_signal_connect (G_OBJECT (dbus_gproxy), "notify::g-name-owner",
-                    G_CALLBACK (wrapper_gproxy_name_owner_changed), NULL);
+  /* map the property ring before the panel starts sending properties */
+  wrapper_ring_attach ();
 
   /* create the type module */
   module = wrapper_module_new (library);
 
-  /* create the plugin provider */
-  provider = wrapper_module_new_provider (module,
-                                          gdk_screen_get_default (),
-                                          name, unique_id,
-                                          display_name, comment,
-                                          arguments);
-
-  if (G_LIKELY (provider != NULL))
+  plugin = wrapper_plugin_new (module, unique_id, socket_id,
+                               name, display_name, comment,
+                               arguments, &retval, &error);
+  if (G_LIKELY (plugin != NULL))
     {
-      /* create the wrapper plug */
-      plug = wrapper_plug_new (socket_id, unique_id, dbus_gproxy, &error);
-      if (plug == NULL)
-        {
-          gtk_widget_destroy (provider);
-          goto leave;
-        }
-
-      gtk_container_add (GTK_CONTAINER (plug), GTK_WIDGET (provider));
-      g_object_add_weak_pointer (G_OBJECT (plug), (gpointer *) &plug);
-      gtk_widget_show (plug);
-
-      /* monitor provider signals */
-      g_signal_connect_swapped (G_OBJECT (provider), "provider-signal",
-                                G_CALLBACK (wrapper_plug_proxy_provider_signal), plug);
-
-      /* connect to service signals */
-      g_signal_connect_object (dbus_gproxy, "g-signal::Set",
-                               G_CALLBACK (wrapper_gproxy_set), provider, G_CONNECT_DEFAULT);
-      g_signal_connect_object (dbus_gproxy, "g-signal::RemoteEvent",
-                               G_CALLBACK (wrapper_gproxy_remote_event), provider, G_CONNECT_DEFAULT);
-
-      /* show the plugin */
-      gtk_widget_show (GTK_WIDGET (provider));
-
       gtk_main ();
 
-      if (retval != PLUGIN_EXIT_SUCCESS_AND_RESTART)
-        retval = plug == NULL || GPOINTER_TO_INT (g_object_get_data (G_OBJECT (plug), "exit-code"));
-
-      /* destroy the plug and provider */
-      if (plug != NULL)
-        gtk_widget_destroy (plug);
-    }
-  else
-    {
-      retval = PLUGIN_EXIT_NO_PROVIDER;
+      retval = wrapper_plugin_get_exit_code (plugin);
+      wrapper_plugin_free (plugin);
     }
 
 leave:
-  if (G_LIKELY (dbus_gproxy != NULL))
-    g_object_unref (G_OBJECT (dbus_gproxy));
+  panel_ring_free (ring);
 
   if (G_LIKELY (module != NULL))
     g_object_unref (G_OBJECT (module));
@@ -45,6 +45,11 @@ G_DEFINE_FINAL_TYPE (WrapperModule, wrapper_module, G_TYPE_TYPE_MODULE)
 
 
 
+/* modules of a wrapper in host mode, by filename */
+static GHashTable *shared_modules = NULL;
+
+
+
 static void
 wrapper_module_class_init (WrapperModuleClass *klass)
 {
@@ -115,6 +120,50 @@ wrapper_module_new (GModule *library)
 
 
 
+WrapperModule *
+wrapper_module_new_shared (const gchar *filename,
+                           GError **error)
+{
+  WrapperModule *module;
+  GModule *library;
+
+  panel_return_val_if_fail (filename != NULL, NULL);
+
+  if (shared_modules == NULL)
+    shared_modules = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+
+  /* the plugin types are registered on the module, so all plugins
+   * from the same library have to share it */
+  module = g_hash_table_lookup (shared_modules, filename);
+  if (module == NULL)
+    {
+      library = g_module_open (filename, G_MODULE_BIND_LOCAL);
+      if (G_UNLIKELY (library == NULL))
+        {
+          g_set_error (error, 0, 0, "Failed to open plugin module \"%s\": %s",
+                       filename, g_module_error ());
+          return NULL;
+        }
+
+      module = wrapper_module_new (library);
+      g_hash_table_insert (shared_modules, g_strdup (filename), module);
+    }
+
+  return g_object_ref (module);
+}
+
+
+
+GModule *
+wrapper_module_get_library (WrapperModule *module)
+{
+  panel_return_val_if_fail (WRAPPER_IS_MODULE (module), NULL);
+
+  return module->library;
+}
+
+
+
 GtkWidget *
 wrapper_module_new_provider (WrapperModule *module,
                              GdkScreen *screen,
@@ -31,6 +31,13 @@ G_DECLARE_FINAL_TYPE (WrapperModule, wrapper_module, WRAPPER, MODULE, GTypeModul
 WrapperModule *
 wrapper_module_new (GModule *library) G_GNUC_MALLOC;
 
+WrapperModule *
+wrapper_module_new_shared (const gchar *filename,
+                           GError **error);
+
+GModule *
+wrapper_module_get_library (WrapperModule *module);
+
 GtkWidget *
 wrapper_module_new_provider (WrapperModule *module,
                              GdkScreen *screen,